@@ -1,29 +1,139 @@
+//  Feature Macros
+#define _GNU_SOURCE
+
 //  Developed Libraries
 #include "circular_queue.h"
 
 
 static uint8_t errorArray[120] = {0};
+
+/*
+    Goal of Function:
+    Split amount bytes starting at index into the contiguous regions of the queue storage.
+    A mirrored queue always gives one region since the storage continues past the wrap point
+*/
+static void queueSplitSpan(circular_queue_t *queue_info, uint32_t index, uint32_t amount, queue_span_t *span) {
+    if (queue_info->flags & QUEUE_FLAG_MIRRORED) {
+        span->data[0] = &queue_info->queue[index];
+        span->len[0] = amount;
+        span->data[1] = queue_info->queue;
+        span->len[1] = 0;
+        return;
+    }
+    uint32_t first = queue_info->max_capacity - index;
+    if (first > amount) {
+        first = amount;
+    }
+    span->data[0] = &queue_info->queue[index];
+    span->len[0] = first;
+    span->data[1] = queue_info->queue;
+    span->len[1] = amount - first;
+}
+
+/*
+    Goal of Function:
+    Map size bytes of a memfd twice, back to back, so the second half mirrors the first.
+    Returns the start of the mapping or NULL on failure
+*/
+static uint8_t *queueMapMirror(uint32_t size) {
+    int32_t fd = memfd_create("circular_queue", MFD_CLOEXEC);
+    if (fd < 0) {
+        snprintf(errorArray, sizeof(errorArray), "%s: Error Creating Mirror memfd\n", __FUNCTION__);
+        perror(errorArray);
+        return NULL;
+    }
+    if (ftruncate(fd, size) != 0) {
+        snprintf(errorArray, sizeof(errorArray), "%s: Error Sizing Mirror memfd\n", __FUNCTION__);
+        perror(errorArray);
+        close(fd);
+        return NULL;
+    }
+    uint8_t *base = mmap(NULL, (size_t) size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        snprintf(errorArray, sizeof(errorArray), "%s: Error Reserving Mirror Address Space\n", __FUNCTION__);
+        perror(errorArray);
+        close(fd);
+        return NULL;
+    }
+    if (mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+        mmap(base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        snprintf(errorArray, sizeof(errorArray), "%s: Error Mapping Mirror\n", __FUNCTION__);
+        perror(errorArray);
+        munmap(base, (size_t) size * 2);
+        close(fd);
+        return NULL;
+    }
+    close(fd);
+    return base;
+}
+
 /*
     Goal of Function:
     Initialize the struct for the queue
 */
 circular_queue_t *queueInit(uint32_t capacity) {
+    return queueInitFlags(capacity, 0);
+}
+
+/*
+    Goal of Function:
+    Initialize the struct for the queue with options
+    QUEUE_FLAG_MIRRORED: back the ring with a memfd mapped twice so every readable or writable
+    span is contiguous. Capacity is rounded up to a multiple of the page size
+    QUEUE_FLAG_LATENCY_HIST: keep the enqueue to dequeue residency histogram
+    QUEUE_POLICY_*: what enqueue does when the data does not fit (drop new, overwrite oldest, block)
+*/
+circular_queue_t *queueInitFlags(uint32_t capacity, uint32_t flags) {
     circular_queue_t *queue_info = (circular_queue_t*) malloc(sizeof(circular_queue_t));
     queue_info->max_capacity = capacity;
     queue_info->front = 0;
     queue_info->rear = 0;
     queue_info->size = 0;
+    queue_info->flags = flags;
+    queue_info->wake_threshold = 1;
+    queue_info->waiters = 0;
+    queue_info->space_waiters = 0;
+    queue_info->block_timeout_us = QUEUE_DEFAULT_BLOCK_TIMEOUT_US;
+    memset(&queue_info->stats, 0, sizeof(queue_stats_t));
+    queue_info->marks = NULL;
+    queue_info->mark_head = 0;
+    queue_info->mark_count = 0;
+    queue_info->spill = NULL;
+    if (flags & QUEUE_FLAG_LATENCY_HIST) {
+        queue_info->marks = calloc(QUEUE_HIST_MARKS, sizeof(queue_mark_t));
+    }
     if (pthread_mutex_init(&queue_info->queueLock, NULL) != 0) {
         snprintf(errorArray, sizeof(errorArray), "%s: Error Initializing Queue Mutex Lock\n", __FUNCTION__);
         perror(errorArray);
         exit(0);
     }
-    if (pthread_cond_init(&queue_info->queueCond, NULL) != 0) {
+    pthread_condattr_t condAttr;
+    pthread_condattr_init(&condAttr);
+    pthread_condattr_setclock(&condAttr, CLOCK_MONOTONIC);
+    if (pthread_cond_init(&queue_info->queueCond, &condAttr) != 0 || pthread_cond_init(&queue_info->spaceCond, &condAttr) != 0) {
         snprintf(errorArray, sizeof(errorArray), "%s: Error Initializing Queue Condition Lock\n", __FUNCTION__);
         perror(errorArray);
         exit(0);
     }
-    queue_info->queue = calloc(capacity, sizeof(uint8_t));
+    pthread_condattr_destroy(&condAttr);
+    if (flags & QUEUE_FLAG_MIRRORED) {
+        uint32_t page = (uint32_t) sysconf(_SC_PAGESIZE);
+        queue_info->max_capacity = ((capacity + page - 1) / page) * page;
+        if (queue_info->max_capacity == 0) {
+            queue_info->max_capacity = page;
+        }
+        if ((queue_info->queue = queueMapMirror(queue_info->max_capacity)) == NULL) {
+            free(queue_info->marks);
+            pthread_mutex_destroy(&queue_info->queueLock);
+            pthread_cond_destroy(&queue_info->queueCond);
+            pthread_cond_destroy(&queue_info->spaceCond);
+            free(queue_info);
+            return NULL;
+        }
+    }
+    else {
+        queue_info->queue = calloc(capacity, sizeof(uint8_t));
+    }
     return queue_info;
 }
 
@@ -32,38 +142,432 @@ circular_queue_t *queueInit(uint32_t capacity) {
     Destroy the struct for the queue
 */
 void queueDestroy(circular_queue_t *queue_info) {
-    free(queue_info->queue);
+    if (queue_info->flags & QUEUE_FLAG_MIRRORED) {
+        munmap(queue_info->queue, (size_t) queue_info->max_capacity * 2);
+    }
+    else {
+        free(queue_info->queue);
+    }
+    if (queue_info->spill != NULL) {
+        munmap(queue_info->spill->map, queue_info->spill->map_size);
+        close(queue_info->spill->fd);
+        free(queue_info->spill);
+    }
+    free(queue_info->marks);
     pthread_mutex_destroy(&queue_info->queueLock);
     pthread_cond_destroy(&queue_info->queueCond);
+    pthread_cond_destroy(&queue_info->spaceCond);
     free(queue_info);
 }
 
+/*
+    Goal of Function:
+    Copy amount bytes in at the rear of the queue. Caller holds queueLock and checked for space
+    Copies the chunk in at most two pieces, one on each side of the wrap point
+*/
+static void queueWriteLocked(circular_queue_t *queue_info, const uint8_t *data, uint32_t amount) {
+    uint32_t index = queue_info->front + queue_info->size;
+    if (index >= queue_info->max_capacity) {
+        index -= queue_info->max_capacity;
+    }
+    queue_span_t span;
+    queueSplitSpan(queue_info, index, amount, &span);
+    memcpy(span.data[0], data, span.len[0]);
+    memcpy(span.data[1], data + span.len[0], span.len[1]);
+    uint32_t rear = index + amount - 1;                                                             //  Wrapped in both modes, the mirror only changes the copy
+    if (rear >= queue_info->max_capacity) {
+        rear -= queue_info->max_capacity;
+    }
+    queue_info->rear = rear;
+    queue_info->size += amount;
+}
+
+/*
+    Goal of Function:
+    Get CLOCK_MONOTONIC in nanoseconds
+*/
+static uint64_t queueNowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000ULL) + (uint64_t) ts.tv_nsec;
+}
+
+/*
+    Goal of Function:
+    Count amount bytes that were just added. Caller holds queueLock
+    With the histogram enabled the first byte of the write is timestamped; writes are
+    sampled when QUEUE_HIST_MARKS marks are already in flight
+*/
+static void queueAccountWriteLocked(circular_queue_t *queue_info, uint32_t amount) {
+    if (queue_info->marks != NULL && queue_info->mark_count < QUEUE_HIST_MARKS) {
+        queue_mark_t *mark = &queue_info->marks[(queue_info->mark_head + queue_info->mark_count) % QUEUE_HIST_MARKS];
+        mark->offset = queue_info->stats.enqueued_bytes;
+        mark->ns = queueNowNs();
+        queue_info->mark_count++;
+    }
+    queue_info->stats.enqueued_bytes += amount;
+    if (queue_info->size > queue_info->stats.high_water) {
+        queue_info->stats.high_water = queue_info->size;
+    }
+}
+
+/*
+    Goal of Function:
+    Count amount bytes that could not be added. Caller holds queueLock
+*/
+static void queueAccountDropLocked(circular_queue_t *queue_info, uint32_t amount) {
+    queue_info->stats.dropped_bytes += amount;
+    queue_info->stats.overflow_events++;
+}
+
+/*
+    Goal of Function:
+    Count amount bytes that just left the queue and record the residency of any timestamped
+    byte among them. Caller holds queueLock
+*/
+static void queueAccountReadLocked(circular_queue_t *queue_info, uint32_t amount) {
+    queue_info->stats.dequeued_bytes += amount;
+    if (queue_info->marks == NULL || queue_info->mark_count == 0) {
+        return;
+    }
+    uint64_t now = 0;
+    uint64_t removed = queue_info->stats.dequeued_bytes + queue_info->stats.overwritten_bytes;
+    while (queue_info->mark_count > 0 && queue_info->marks[queue_info->mark_head].offset < removed) {
+        if (now == 0) {
+            now = queueNowNs();
+        }
+        uint64_t residency = now - queue_info->marks[queue_info->mark_head].ns;
+        uint32_t bucket = (residency < 2) ? 0 : (63 - __builtin_clzll(residency));
+        if (bucket >= QUEUE_HIST_BUCKETS) {
+            bucket = QUEUE_HIST_BUCKETS - 1;
+        }
+        queue_info->stats.residency_hist[bucket]++;
+        queue_info->mark_head = (queue_info->mark_head + 1) % QUEUE_HIST_MARKS;
+        queue_info->mark_count--;
+    }
+}
+
+/*
+    Goal of Function:
+    Check if amount new bytes have to go to the spill file. Caller holds queueLock
+    Once anything is spilled all new data follows it there until it drained, so order is kept
+*/
+static uint8_t queueSpillWantedLocked(circular_queue_t *queue_info, uint32_t amount) {
+    queue_spill_t *spill = queue_info->spill;
+    if (spill == NULL) {
+        return 0;
+    }
+    return (spill->write_off != spill->read_off) || ((queue_info->size + amount) > spill->threshold);
+}
+
+/*
+    Goal of Function:
+    Make sure amount more bytes fit in the spill mapping, growing the file a segment at a time.
+    Caller holds queueLock. Returns 1 on success and 0 if the file could not grow
+*/
+static uint8_t queueSpillGrowLocked(circular_queue_t *queue_info, uint32_t amount) {
+    queue_spill_t *spill = queue_info->spill;
+    uint64_t need = spill->write_off + amount;
+    if (need <= spill->map_size) {
+        return 1;
+    }
+    uint64_t new_size = ((need + QUEUE_SPILL_SEGMENT_SIZE - 1) / QUEUE_SPILL_SEGMENT_SIZE) * QUEUE_SPILL_SEGMENT_SIZE;
+    if (ftruncate(spill->fd, new_size) != 0) {
+        return 0;
+    }
+    uint8_t *map = mremap(spill->map, spill->map_size, new_size, MREMAP_MAYMOVE);
+    if (map == MAP_FAILED) {
+        return 0;
+    }
+    spill->map = map;
+    spill->map_size = new_size;
+    return 1;
+}
+
+/*
+    Goal of Function:
+    Append amount bytes to the spill file. Caller holds queueLock and grew the mapping
+*/
+static void queueSpillAppendLocked(circular_queue_t *queue_info, const uint8_t *data, uint32_t amount) {
+    queue_spill_t *spill = queue_info->spill;
+    memcpy(&spill->map[spill->write_off], data, amount);
+    spill->write_off += amount;
+    queue_info->stats.spilled_bytes += amount;
+}
+
+/*
+    Goal of Function:
+    Release the whole segments in front of read_off so the file and mapping stay bounded by the backlog.
+    Caller holds queueLock. The segments are collapsed out of the file where the filesystem supports it,
+    otherwise the pending data is moved down once it is no bigger than what was consumed (so every byte
+    is moved at most once on average) and the consumed segments are only punched until then
+*/
+static void queueSpillCompactLocked(queue_spill_t *spill) {
+    uint64_t consumed = (spill->read_off / QUEUE_SPILL_SEGMENT_SIZE) * QUEUE_SPILL_SEGMENT_SIZE;
+    if (consumed == 0) {
+        return;
+    }
+    if (fallocate(spill->fd, FALLOC_FL_COLLAPSE_RANGE, 0, consumed) != 0) {
+        if ((spill->write_off - spill->read_off) > consumed) {
+            if (consumed > spill->punched_off) {
+                fallocate(spill->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, spill->punched_off, consumed - spill->punched_off);
+                spill->punched_off = consumed;
+            }
+            return;
+        }
+        memmove(spill->map, &spill->map[consumed], spill->write_off - consumed);
+    }
+    if (ftruncate(spill->fd, spill->map_size - consumed) == 0) {                                    //  A collapse already shrank the file
+        uint8_t *map = mremap(spill->map, spill->map_size, spill->map_size - consumed, 0);          //  Shrinking never moves the mapping
+        if (map != MAP_FAILED) {
+            spill->map = map;
+            spill->map_size -= consumed;
+        }
+    }
+    spill->read_off -= consumed;
+    spill->write_off -= consumed;
+    spill->punched_off = 0;
+}
+
+/*
+    Goal of Function:
+    Move spilled data back into the ring until it holds level bytes. Caller holds queueLock
+    Only the consume paths refill, so every spilled byte is copied in once, when the consumer
+    needs it, and the ring stays at the spill threshold while a backlog is pending
+    level: Fill level to top the ring up to, the spill threshold unless a record needs more
+*/
+static void queueSpillRefillLocked(circular_queue_t *queue_info, uint32_t level) {
+    queue_spill_t *spill = queue_info->spill;
+    uint64_t pending = spill->write_off - spill->read_off;
+    if (level > queue_info->max_capacity) {
+        level = queue_info->max_capacity;
+    }
+    if (pending == 0 || queue_info->size >= level) {
+        return;
+    }
+    uint32_t room = level - queue_info->size;
+    uint32_t amount = (pending < room) ? (uint32_t) pending : room;
+    queueWriteLocked(queue_info, &spill->map[spill->read_off], amount);
+    spill->read_off += amount;
+    if (spill->read_off == spill->write_off) {
+        fallocate(spill->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, 0, spill->write_off);
+        spill->read_off = 0;
+        spill->write_off = 0;
+        spill->punched_off = 0;
+    }
+    else if (spill->read_off >= QUEUE_SPILL_SEGMENT_SIZE) {
+        queueSpillCompactLocked(spill);
+    }
+}
+
+/*
+    Goal of Function:
+    Store a chunk when the spill file has to take it. Caller holds queueLock
+    If nothing is spilled yet the ring is topped up to the threshold first and the rest is spilled.
+    If the file can not grow while it holds data the chunk is dropped, it may not pass the backlog.
+    Returns 1 if the chunk was stored or dropped and 0 if the normal ring path should handle it
+*/
+static uint8_t queueSpillStoreLocked(circular_queue_t *queue_info, const uint8_t *data, uint32_t amount) {
+    if (!queueSpillWantedLocked(queue_info, amount)) {
+        return 0;
+    }
+    queue_spill_t *spill = queue_info->spill;
+    uint32_t ring_part = 0;
+    if (spill->write_off == spill->read_off && queue_info->size < spill->threshold) {
+        ring_part = spill->threshold - queue_info->size;
+    }
+    if (!queueSpillGrowLocked(queue_info, amount - ring_part)) {
+        if (spill->write_off == spill->read_off) {
+            return 0;
+        }
+        queueAccountDropLocked(queue_info, amount);
+        return 1;
+    }
+    queueSpillAppendLocked(queue_info, data + ring_part, amount - ring_part);
+    if (ring_part > 0) {
+        queueWriteLocked(queue_info, data, ring_part);
+    }
+    queueAccountWriteLocked(queue_info, amount);
+    return 1;
+}
+
+/*
+    Goal of Function:
+    Drop amount bytes from the front of the queue. Caller holds queueLock and checked the size
+*/
+static void queueConsumeLocked(circular_queue_t *queue_info, uint32_t amount) {
+    queue_info->front = (queue_info->front + amount) % queue_info->max_capacity;
+    queue_info->size -= amount;
+    queueAccountReadLocked(queue_info, amount);
+    if (queue_info->spill != NULL) {
+        queueSpillRefillLocked(queue_info, queue_info->spill->threshold);
+    }
+    if (queue_info->space_waiters > 0 && amount > 0) {
+        pthread_cond_broadcast(&queue_info->spaceCond);
+    }
+}
+
+/*
+    Goal of Function:
+    Throw away amount of the oldest bytes to make room (overwrite policy). Caller holds queueLock
+    Timestamps of the discarded bytes are dropped without going into the histogram
+*/
+static void queueOverwriteLocked(circular_queue_t *queue_info, uint32_t amount) {
+    queue_info->front = (queue_info->front + amount) % queue_info->max_capacity;
+    queue_info->size -= amount;
+    queue_info->stats.overwritten_bytes += amount;
+    queue_info->stats.overflow_events++;
+    uint64_t removed = queue_info->stats.dequeued_bytes + queue_info->stats.overwritten_bytes;
+    while (queue_info->mark_count > 0 && queue_info->marks[queue_info->mark_head].offset < removed) {
+        queue_info->mark_head = (queue_info->mark_head + 1) % QUEUE_HIST_MARKS;
+        queue_info->mark_count--;
+    }
+}
+
+/*
+    Goal of Function:
+    Apply the overflow policy so amount bytes fit. Caller holds queueLock
+    Drop new: nothing to do. Overwrite: discard the oldest bytes in one step.
+    Block: sleep on spaceCond until space frees up or the block timeout expires.
+    Returns 1 if amount bytes fit now and 0 if the data has to be dropped
+*/
+static uint8_t queueMakeRoomLocked(circular_queue_t *queue_info, uint32_t amount) {
+    if ((queue_info->max_capacity - queue_info->size) >= amount) {
+        return 1;
+    }
+    if (amount > queue_info->max_capacity) {
+        return 0;
+    }
+    switch (queue_info->flags & QUEUE_POLICY_MASK) {
+        case QUEUE_POLICY_OVERWRITE:
+            queueOverwriteLocked(queue_info, amount - (queue_info->max_capacity - queue_info->size));
+            return 1;
+
+        case QUEUE_POLICY_BLOCK: {
+            struct timespec deadline;
+            clock_gettime(CLOCK_MONOTONIC, &deadline);
+            deadline.tv_sec += queue_info->block_timeout_us / 1000000;
+            deadline.tv_nsec += (queue_info->block_timeout_us % 1000000) * 1000;
+            if (deadline.tv_nsec >= 1000000000) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000;
+            }
+            queue_info->space_waiters++;
+            while ((queue_info->max_capacity - queue_info->size) < amount) {
+                if (pthread_cond_timedwait(&queue_info->spaceCond, &queue_info->queueLock, &deadline) == ETIMEDOUT) {
+                    break;
+                }
+            }
+            queue_info->space_waiters--;
+            return ((queue_info->max_capacity - queue_info->size) >= amount);
+        }
+
+        default:
+            return 0;
+    }
+}
+
+/*
+    Goal of Function:
+    Copy amount bytes out from the front of the queue. Caller holds queueLock and checked the size
+    Copies the data out in at most two pieces, one on each side of the wrap point
+*/
+static void queueReadLocked(circular_queue_t *queue_info, uint8_t *data, uint32_t amount) {
+    queue_span_t span;
+    queueSplitSpan(queue_info, queue_info->front, amount, &span);
+    memcpy(data, span.data[0], span.len[0]);
+    memcpy(data + span.len[0], span.data[1], span.len[1]);
+    queueConsumeLocked(queue_info, amount);
+}
+
+/*
+    Goal of Function:
+    Wake waiting consumers when the queue stops being empty or the fill level crosses the wake
+    threshold. Caller holds queueLock. Only those two edges signal, so a burst of enqueues costs
+    at most two wake ups instead of one per byte
+*/
+static void queueNotifyLocked(circular_queue_t *queue_info, uint32_t old_size) {
+    if (queue_info->waiters == 0 || queue_info->size == old_size) {
+        return;
+    }
+    if (old_size == 0 || (old_size < queue_info->wake_threshold && queue_info->size >= queue_info->wake_threshold)) {
+        pthread_cond_broadcast(&queue_info->queueCond);
+    }
+}
+
+/*
+    Goal of Function:
+    Sleep on queueCond until level bytes are queued or the deadline passes. Caller holds queueLock
+    level: Fill level to wait for, 1 for any data
+    deadline: CLOCK_MONOTONIC deadline, NULL waits forever
+*/
+static void queueWaitLocked(circular_queue_t *queue_info, uint32_t level, const struct timespec *deadline) {
+    queue_info->waiters++;
+    while (queue_info->size < level) {
+        if (deadline == NULL) {
+            pthread_cond_wait(&queue_info->queueCond, &queue_info->queueLock);
+        }
+        else if (pthread_cond_timedwait(&queue_info->queueCond, &queue_info->queueLock, deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    queue_info->waiters--;
+}
+
 /*
     Goal of Function:
     Add data to the queue
 */
 void enqueue(circular_queue_t *queue_info, uint8_t data) {
-    if (queue_info->size == queue_info->max_capacity) {
-        printf("%s: Queue Overflow, not performing\n", __FUNCTION__);
+    pthread_mutex_lock(&queue_info->queueLock);
+    uint32_t old_size = queue_info->size;
+    if (queueSpillStoreLocked(queue_info, &data, 1)) {
+        queueNotifyLocked(queue_info, old_size);
+        pthread_mutex_unlock(&queue_info->queueLock);
         return;
     }
-    queue_info->rear = (queue_info->front + queue_info->size) % queue_info->max_capacity;
-    queue_info->queue[queue_info->rear] = data;
-    queue_info->size++;
+    if (!queueMakeRoomLocked(queue_info, 1)) {
+        queueAccountDropLocked(queue_info, 1);
+        pthread_mutex_unlock(&queue_info->queueLock);
+        return;
+    }
+    old_size = queue_info->size;
+    queueWriteLocked(queue_info, &data, 1);
+    queueAccountWriteLocked(queue_info, 1);
+    queueNotifyLocked(queue_info, old_size);
+    pthread_mutex_unlock(&queue_info->queueLock);
 }
 
 /*
     Goal of Function:
     Enqueue chunk
+    With the overwrite policy a chunk larger than the queue keeps only its newest max_capacity bytes
 */
 void enqueueChunk(circular_queue_t *queue_info, uint8_t *data, uint32_t amount) {
-    if ((queue_info->max_capacity - queue_info->size) < amount) {
-        printf("%s: Queue Will Overflow, not performing\n", __FUNCTION__);
+    pthread_mutex_lock(&queue_info->queueLock);
+    uint32_t spill_old_size = queue_info->size;
+    if (amount > 0 && queueSpillStoreLocked(queue_info, data, amount)) {
+        queueNotifyLocked(queue_info, spill_old_size);
+        pthread_mutex_unlock(&queue_info->queueLock);
+        return;
+    }
+    if ((queue_info->flags & QUEUE_POLICY_MASK) == QUEUE_POLICY_OVERWRITE && amount > queue_info->max_capacity) {
+        queueAccountDropLocked(queue_info, amount - queue_info->max_capacity);
+        data += amount - queue_info->max_capacity;
+        amount = queue_info->max_capacity;
+    }
+    if (!queueMakeRoomLocked(queue_info, amount)) {
+        queueAccountDropLocked(queue_info, amount);
+        pthread_mutex_unlock(&queue_info->queueLock);
         return;
     }
-    for (uint32_t i = 0; i < amount; i++) {
-        enqueue(queue_info, data[i]);
+    if (amount > 0) {
+        uint32_t old_size = queue_info->size;
+        queueWriteLocked(queue_info, data, amount);
+        queueAccountWriteLocked(queue_info, amount);
+        queueNotifyLocked(queue_info, old_size);
     }
+    pthread_mutex_unlock(&queue_info->queueLock);
 }
 
 /*
@@ -71,15 +575,49 @@ void enqueueChunk(circular_queue_t *queue_info, uint8_t *data, uint32_t amount)
     Remove data to the queue
 */
 uint8_t dequeue(circular_queue_t *queue_info, uint8_t *isThereData) {
+    uint8_t data = 0;
+    pthread_mutex_lock(&queue_info->queueLock);
+    *isThereData = (queue_info->size > 0);
+    if (*isThereData) {
+        queueReadLocked(queue_info, &data, 1);
+    }
+    pthread_mutex_unlock(&queue_info->queueLock);
+    return data;
+}
+
+/*
+    Goal of Function:
+    Remove data from the queue, sleeping until data arrives instead of polling
+    Returns as soon as anything is queued, the wake threshold only batches dequeueChunkTimed
+*/
+uint8_t dequeueWait(circular_queue_t *queue_info, uint8_t *isThereData) {
+    uint8_t data = 0;
+    pthread_mutex_lock(&queue_info->queueLock);
+    queueWaitLocked(queue_info, 1, NULL);                                                           //  Untimed, so any data ends the wait
+    *isThereData = (queue_info->size > 0);
+    if (*isThereData) {
+        queueReadLocked(queue_info, &data, 1);
+    }
+    pthread_mutex_unlock(&queue_info->queueLock);
+    return data;
+}
+
+/*
+    Goal of Function:
+    Dequeue all data (locked, caller holds queueLock)
+*/
+static uint8_t *dequeueChunkLocked(circular_queue_t *queue_info, uint32_t *amount) {
+    *amount = 0;
     if (queue_info->size == 0) {
-        *isThereData = 0;
         return 0;
     }
-    *isThereData = 1;
-    int32_t data = queue_info->queue[queue_info->front];
-    queue_info->front = (queue_info->front + 1) % queue_info->max_capacity;
-    queue_info->size--;
-    return data;
+    uint8_t *allData = malloc(queue_info->size);
+    if (allData == NULL) {
+        return 0;
+    }
+    *amount = queue_info->size;
+    queueReadLocked(queue_info, allData, queue_info->size);
+    return allData;
 }
 
 /*
@@ -87,18 +625,476 @@ uint8_t dequeue(circular_queue_t *queue_info, uint8_t *isThereData) {
     Dequeue all data
 */
 uint8_t *dequeueChunk(circular_queue_t *queue_info, uint32_t *amount) {
-    if (queue_info->size == 0) {
-        *amount = 0;
+    pthread_mutex_lock(&queue_info->queueLock);
+    uint8_t *allData = dequeueChunkLocked(queue_info, amount);
+    pthread_mutex_unlock(&queue_info->queueLock);
+    return allData;
+}
+
+/*
+    Goal of Function:
+    Dequeue all data once the wake threshold is reached or the timeout expires, sleeping in between.
+    Data below the threshold is returned when the timeout expires
+    secs: Timeout seconds
+    usecs: Timeout useconds
+    Returns whatever is in the queue at wake up, amount is 0 if the timeout expired on an empty queue
+*/
+uint8_t *dequeueChunkTimed(circular_queue_t *queue_info, uint32_t *amount, uint32_t secs, uint32_t usecs) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += secs + (usecs / 1000000);
+    deadline.tv_nsec += (usecs % 1000000) * 1000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+    pthread_mutex_lock(&queue_info->queueLock);
+    queueWaitLocked(queue_info, queue_info->wake_threshold, &deadline);                             //  The deadline bounds the batching
+    uint8_t *allData = dequeueChunkLocked(queue_info, amount);
+    pthread_mutex_unlock(&queue_info->queueLock);
+    return allData;
+}
+
+/*
+    Goal of Function:
+    Set the fill level that ends a dequeueChunkTimed wait early. 1 (default) wakes on empty to
+    non-empty, larger values batch wake ups until that many bytes are queued or the timeout expires
+*/
+void queueSetWakeThreshold(circular_queue_t *queue_info, uint32_t threshold) {
+    if (threshold == 0) {
+        threshold = 1;
+    }
+    if (threshold > queue_info->max_capacity) {
+        threshold = queue_info->max_capacity;
+    }
+    pthread_mutex_lock(&queue_info->queueLock);
+    queue_info->wake_threshold = threshold;
+    if (queue_info->waiters > 0 && queue_info->size >= threshold) {
+        pthread_cond_broadcast(&queue_info->queueCond);
+    }
+    pthread_mutex_unlock(&queue_info->queueLock);
+}
+
+/*
+    Goal of Function:
+    Set how long producers wait for space under QUEUE_POLICY_BLOCK before dropping the data
+    secs: Timeout seconds
+    usecs: Timeout useconds
+*/
+void queueSetBlockTimeout(circular_queue_t *queue_info, uint32_t secs, uint32_t usecs) {
+    pthread_mutex_lock(&queue_info->queueLock);
+    queue_info->block_timeout_us = ((uint64_t)secs * 1000000) + usecs;
+    pthread_mutex_unlock(&queue_info->queueLock);
+}
+
+/*
+    Goal of Function:
+    Reserve the free space of the queue so the producer can write into it directly.
+    span is filled with up to two contiguous regions, the second one is used when the free space wraps.
+    Returns the total amount of free bytes. Nothing is visible to the consumer until queueCommit.
+    While spilled data is pending there is no free space, so writes cannot jump ahead of it
+*/
+uint32_t queueReserve(circular_queue_t *queue_info, queue_span_t *span) {
+    pthread_mutex_lock(&queue_info->queueLock);
+    uint32_t index = queue_info->front + queue_info->size;
+    if (index >= queue_info->max_capacity) {
+        index -= queue_info->max_capacity;
+    }
+    uint32_t amount = queue_info->max_capacity - queue_info->size;
+    if (queue_info->spill != NULL && queue_info->spill->write_off != queue_info->spill->read_off) {
+        amount = 0;
+    }
+    queueSplitSpan(queue_info, index, amount, span);
+    pthread_mutex_unlock(&queue_info->queueLock);
+    return amount;
+}
+
+/*
+    Goal of Function:
+    Publish amount bytes that were written into the regions returned by queueReserve
+*/
+void queueCommit(circular_queue_t *queue_info, uint32_t amount) {
+    pthread_mutex_lock(&queue_info->queueLock);
+    if (amount > (queue_info->max_capacity - queue_info->size)) {
+        amount = queue_info->max_capacity - queue_info->size;
+    }
+    if (amount > 0) {
+        uint32_t old_size = queue_info->size;
+        queue_info->size += amount;
+        queue_info->rear = (queue_info->front + queue_info->size - 1) % queue_info->max_capacity;
+        queueAccountWriteLocked(queue_info, amount);
+        queueNotifyLocked(queue_info, old_size);
+    }
+    pthread_mutex_unlock(&queue_info->queueLock);
+}
+
+/*
+    Goal of Function:
+    View the data in the queue in place without copying it out.
+    span is filled with up to two contiguous regions, the second one is used when the data wraps.
+    Returns the total amount of readable bytes. The data stays in the queue until queueConsume
+*/
+uint32_t queuePeek(circular_queue_t *queue_info, queue_span_t *span) {
+    pthread_mutex_lock(&queue_info->queueLock);
+    uint32_t amount = queue_info->size;
+    queueSplitSpan(queue_info, queue_info->front, amount, span);
+    pthread_mutex_unlock(&queue_info->queueLock);
+    return amount;
+}
+
+/*
+    Goal of Function:
+    Release amount bytes from the front of the queue after they were handled through queuePeek
+*/
+void queueConsume(circular_queue_t *queue_info, uint32_t amount) {
+    pthread_mutex_lock(&queue_info->queueLock);
+    if (amount > queue_info->size) {
+        amount = queue_info->size;
+    }
+    queueConsumeLocked(queue_info, amount);
+    pthread_mutex_unlock(&queue_info->queueLock);
+}
+
+/*
+    Goal of Function:
+    Copy amount bytes starting offset bytes past the front without removing them. Caller holds queueLock
+*/
+static void queueCopyOutLocked(circular_queue_t *queue_info, uint32_t offset, uint8_t *data, uint32_t amount) {
+    queue_span_t span;
+    queueSplitSpan(queue_info, (queue_info->front + offset) % queue_info->max_capacity, amount, &span);
+    memcpy(data, span.data[0], span.len[0]);
+    memcpy(data + span.len[0], span.data[1], span.len[1]);
+}
+
+/*
+    Goal of Function:
+    Read the length of the oldest record if the whole record is in the ring. Caller holds queueLock
+    The ring only holds the spill threshold while spilled data is pending, so a record cut at that
+    level is completed from the spill file first. Returns 1 if a whole record is available
+*/
+static uint8_t queueRecordLenLocked(circular_queue_t *queue_info, uint32_t *len) {
+    if (queue_info->spill != NULL) {
+        queueSpillRefillLocked(queue_info, QUEUE_RECORD_HEADER_SIZE);
+    }
+    if (queue_info->size < QUEUE_RECORD_HEADER_SIZE) {
         return 0;
     }
-    *amount = queue_info->size;
-    uint8_t *allData = calloc(queue_info->size, sizeof(uint8_t));
-    uint8_t isThereData = 1;
-    uint32_t dataByte = 0;
-    while (isThereData) {
-        allData[dataByte++] = dequeue(queue_info, &isThereData);
+    queueCopyOutLocked(queue_info, 0, (uint8_t *) len, QUEUE_RECORD_HEADER_SIZE);
+    if (queue_info->spill != NULL) {
+        queueSpillRefillLocked(queue_info, QUEUE_RECORD_HEADER_SIZE + *len);
     }
+    return ((queue_info->size - QUEUE_RECORD_HEADER_SIZE) >= *len);
+}
 
-    return allData;
+/*
+    Goal of Function:
+    Enqueue one length prefixed record, stored as [uint32_t len][payload]
+    The whole record is added or nothing is, and it only becomes visible once both parts are in.
+    The overwrite policy discards whole records from the front so framing is never broken.
+    With spill on an empty ring always takes the record (the ring is never empty while spilled data
+    is pending), so a lone record larger than the threshold does not wait in the file.
+    Returns 1 on success and 0 if it does not fit or len is 0
+*/
+uint8_t enqueueRecord(circular_queue_t *queue_info, const uint8_t *data, uint32_t len) {
+    if (len == 0) {
+        return 0;
+    }
+    pthread_mutex_lock(&queue_info->queueLock);
+    uint8_t fits = 0;
+    if (len <= (queue_info->max_capacity - QUEUE_RECORD_HEADER_SIZE) && queue_info->size > 0 && queueSpillWantedLocked(queue_info, QUEUE_RECORD_HEADER_SIZE + len)) {
+        if (queueSpillGrowLocked(queue_info, QUEUE_RECORD_HEADER_SIZE + len)) {                     //  Spilled whole, the consumer refills it in order
+            queueSpillAppendLocked(queue_info, (const uint8_t *) &len, QUEUE_RECORD_HEADER_SIZE);
+            queueSpillAppendLocked(queue_info, data, len);
+            queueAccountWriteLocked(queue_info, QUEUE_RECORD_HEADER_SIZE + len);
+            pthread_mutex_unlock(&queue_info->queueLock);
+            return 1;
+        }
+        if (queue_info->spill->write_off != queue_info->spill->read_off) {                          //  Can not pass the spilled backlog
+            queueAccountDropLocked(queue_info, QUEUE_RECORD_HEADER_SIZE + len);
+            pthread_mutex_unlock(&queue_info->queueLock);
+            return 0;
+        }
+    }
+    if (len <= (queue_info->max_capacity - QUEUE_RECORD_HEADER_SIZE)) {
+        if ((queue_info->flags & QUEUE_POLICY_MASK) == QUEUE_POLICY_OVERWRITE) {
+            while ((queue_info->max_capacity - queue_info->size) < (QUEUE_RECORD_HEADER_SIZE + len)) {
+                uint32_t oldest = 0;
+                queueCopyOutLocked(queue_info, 0, (uint8_t *) &oldest, QUEUE_RECORD_HEADER_SIZE);
+                queueOverwriteLocked(queue_info, QUEUE_RECORD_HEADER_SIZE + oldest);
+            }
+            fits = 1;
+        }
+        else {
+            fits = queueMakeRoomLocked(queue_info, QUEUE_RECORD_HEADER_SIZE + len);
+        }
+    }
+    if (!fits) {
+        queueAccountDropLocked(queue_info, QUEUE_RECORD_HEADER_SIZE + len);
+        pthread_mutex_unlock(&queue_info->queueLock);
+        return 0;
+    }
+    uint32_t old_size = queue_info->size;
+    queueWriteLocked(queue_info, (const uint8_t *) &len, QUEUE_RECORD_HEADER_SIZE);
+    queueWriteLocked(queue_info, data, len);
+    queueAccountWriteLocked(queue_info, QUEUE_RECORD_HEADER_SIZE + len);
+    queueNotifyLocked(queue_info, old_size);
+    pthread_mutex_unlock(&queue_info->queueLock);
+    return 1;
+}
+
+/*
+    Goal of Function:
+    Dequeue one whole record into data
+    Returns the record length, 0 if there is no record, or -1 if max_len is too small (the record is kept)
+*/
+int32_t dequeueRecord(circular_queue_t *queue_info, uint8_t *data, uint32_t max_len) {
+    uint32_t len = 0;
+    pthread_mutex_lock(&queue_info->queueLock);
+    if (!queueRecordLenLocked(queue_info, &len)) {
+        pthread_mutex_unlock(&queue_info->queueLock);
+        return 0;
+    }
+    if (len > max_len) {
+        pthread_mutex_unlock(&queue_info->queueLock);
+        return -1;
+    }
+    queueConsumeLocked(queue_info, QUEUE_RECORD_HEADER_SIZE);
+    queueReadLocked(queue_info, data, len);
+    pthread_mutex_unlock(&queue_info->queueLock);
+    return (int32_t) len;
+}
+
+/*
+    Goal of Function:
+    View the payload of the oldest record in place.
+    span is filled with up to two contiguous regions (always one for a mirrored queue).
+    Returns the payload length, 0 if there is no record. The record stays until queueConsumeRecord
+*/
+uint32_t queuePeekRecord(circular_queue_t *queue_info, queue_span_t *span) {
+    uint32_t len = 0;
+    pthread_mutex_lock(&queue_info->queueLock);
+    if (queueRecordLenLocked(queue_info, &len)) {
+        queueSplitSpan(queue_info, (queue_info->front + QUEUE_RECORD_HEADER_SIZE) % queue_info->max_capacity, len, span);
+    }
+    pthread_mutex_unlock(&queue_info->queueLock);
+    return len;
+}
+
+/*
+    Goal of Function:
+    Release the oldest record after it was handled through queuePeekRecord
+*/
+void queueConsumeRecord(circular_queue_t *queue_info) {
+    uint32_t len = 0;
+    pthread_mutex_lock(&queue_info->queueLock);
+    if (queueRecordLenLocked(queue_info, &len)) {
+        queueConsumeLocked(queue_info, QUEUE_RECORD_HEADER_SIZE + len);
+    }
+    pthread_mutex_unlock(&queue_info->queueLock);
+}
+
+/*
+    Goal of Function:
+    Take a snapshot of the queue counters
+*/
+void queueGetStats(circular_queue_t *queue_info, queue_stats_t *stats) {
+    pthread_mutex_lock(&queue_info->queueLock);
+    memcpy(stats, &queue_info->stats, sizeof(queue_stats_t));
+    stats->size = queue_info->size;
+    stats->max_capacity = queue_info->max_capacity;
+    if (queue_info->spill != NULL) {
+        stats->spill_pending = queue_info->spill->write_off - queue_info->spill->read_off;
+    }
+    pthread_mutex_unlock(&queue_info->queueLock);
+}
+
+/*
+    Goal of Function:
+    Turn on disk spill. Once the ring holds threshold bytes, further data is appended to an mmap'd
+    segment file and read back in order as the consumer drains the ring, so nothing is lost or
+    reordered while memory stays bounded by the ring capacity.
+    spill_path: Path of the spill file, it is unlinked right away and only lives while the queue does
+    threshold: Ring fill level that starts spilling (clamped to 1 ... capacity)
+*/
+int32_t queueEnableSpill(circular_queue_t *queue_info, const uint8_t *spill_path, uint32_t threshold) {
+    queue_spill_t *spill = calloc(1, sizeof(queue_spill_t));
+    if (spill == NULL) {
+        snprintf(errorArray, sizeof(errorArray), "%s: Error Allocating Spill\n", __FUNCTION__);
+        perror(errorArray);
+        return -1;
+    }
+    if ((spill->fd = open((const char *) spill_path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600)) < 0) {
+        snprintf(errorArray, sizeof(errorArray), "%s: Error Opening Spill File\n", __FUNCTION__);
+        perror(errorArray);
+        free(spill);
+        return -1;
+    }
+    unlink((const char *) spill_path);
+    spill->map_size = QUEUE_SPILL_SEGMENT_SIZE;
+    if (ftruncate(spill->fd, spill->map_size) != 0 ||
+        (spill->map = mmap(NULL, spill->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, spill->fd, 0)) == MAP_FAILED) {
+        snprintf(errorArray, sizeof(errorArray), "%s: Error Mapping Spill File\n", __FUNCTION__);
+        perror(errorArray);
+        close(spill->fd);
+        free(spill);
+        return -1;
+    }
+    spill->threshold = (threshold > queue_info->max_capacity) ? queue_info->max_capacity : threshold;
+    if (spill->threshold == 0) {
+        spill->threshold = 1;
+    }
+    pthread_mutex_lock(&queue_info->queueLock);
+    if (queue_info->wake_threshold > spill->threshold) {
+        queue_info->wake_threshold = spill->threshold;
+    }
+    queue_info->spill = spill;
+    pthread_mutex_unlock(&queue_info->queueLock);
+    return 1;
+}
+
+/*
+    Goal of Function:
+    Round capacity up to the next power of two so indices can be masked instead of using modulo
+*/
+static uint32_t roundUpPowerOfTwo(uint32_t capacity) {
+    uint32_t power = 1;
+    while (power < capacity && power < 0x80000000U) {
+        power <<= 1;
+    }
+    return power;
+}
+
+/*
+    Goal of Function:
+    Initialize the struct for the single producer single consumer queue.
+    Capacity is rounded up to a power of two. head/tail are free running and only masked on access.
+*/
+spsc_queue_t *spscQueueInit(uint32_t capacity) {
+    spsc_queue_t *queue_info = NULL;
+    if (posix_memalign((void **) &queue_info, QUEUE_CACHE_LINE_SIZE, sizeof(spsc_queue_t)) != 0) {
+        snprintf(errorArray, sizeof(errorArray), "%s: Error Allocating Queue\n", __FUNCTION__);
+        perror(errorArray);
+        return NULL;
+    }
+    memset(queue_info, 0, sizeof(spsc_queue_t));
+    queue_info->max_capacity = roundUpPowerOfTwo(capacity);
+    queue_info->mask = queue_info->max_capacity - 1;
+    atomic_init(&queue_info->head, 0);
+    atomic_init(&queue_info->tail, 0);
+    queue_info->queue = calloc(queue_info->max_capacity, sizeof(uint8_t));
+    if (queue_info->queue == NULL) {
+        snprintf(errorArray, sizeof(errorArray), "%s: Error Allocating Queue Buffer\n", __FUNCTION__);
+        perror(errorArray);
+        free(queue_info);
+        return NULL;
+    }
+    return queue_info;
+}
+
+/*
+    Goal of Function:
+    Destroy the struct for the single producer single consumer queue
+*/
+void spscQueueDestroy(spsc_queue_t *queue_info) {
+    free(queue_info->queue);
+    free(queue_info);
+}
+
+/*
+    Goal of Function:
+    Get the amount of data currently in the queue (approximate while the other side is running)
+*/
+uint32_t spscQueueSize(spsc_queue_t *queue_info) {
+    uint32_t head = atomic_load_explicit(&queue_info->head, memory_order_acquire);                  //  Head first, tail only grows so tail - head can not wrap
+    uint32_t tail = atomic_load_explicit(&queue_info->tail, memory_order_acquire);
+    return tail - head;
+}
+
+/*
+    Goal of Function:
+    Add data to the queue. Producer thread only.
+    Returns 1 on success and 0 if the queue is full
+*/
+uint8_t spscEnqueue(spsc_queue_t *queue_info, uint8_t data) {
+    uint32_t tail = atomic_load_explicit(&queue_info->tail, memory_order_relaxed);
+    if ((tail - queue_info->cached_head) == queue_info->max_capacity) {
+        queue_info->cached_head = atomic_load_explicit(&queue_info->head, memory_order_acquire);
+        if ((tail - queue_info->cached_head) == queue_info->max_capacity) {
+            return 0;
+        }
+    }
+    queue_info->queue[tail & queue_info->mask] = data;
+    atomic_store_explicit(&queue_info->tail, tail + 1, memory_order_release);
+    return 1;
+}
+
+/*
+    Goal of Function:
+    Enqueue chunk. Producer thread only.
+    The whole chunk is added or nothing is. Returns 1 on success and 0 if it does not fit
+*/
+uint8_t spscEnqueueChunk(spsc_queue_t *queue_info, const uint8_t *data, uint32_t amount) {
+    uint32_t tail = atomic_load_explicit(&queue_info->tail, memory_order_relaxed);
+    if ((queue_info->max_capacity - (tail - queue_info->cached_head)) < amount) {
+        queue_info->cached_head = atomic_load_explicit(&queue_info->head, memory_order_acquire);
+        if ((queue_info->max_capacity - (tail - queue_info->cached_head)) < amount) {
+            return 0;
+        }
+    }
+    uint32_t index = tail & queue_info->mask;
+    uint32_t first = queue_info->max_capacity - index;
+    if (first > amount) {
+        first = amount;
+    }
+    memcpy(&queue_info->queue[index], data, first);
+    memcpy(queue_info->queue, data + first, amount - first);
+    atomic_store_explicit(&queue_info->tail, tail + amount, memory_order_release);
+    return 1;
+}
+
+/*
+    Goal of Function:
+    Remove data from the queue. Consumer thread only.
+*/
+uint8_t spscDequeue(spsc_queue_t *queue_info, uint8_t *isThereData) {
+    uint32_t head = atomic_load_explicit(&queue_info->head, memory_order_relaxed);
+    if (head == queue_info->cached_tail) {
+        queue_info->cached_tail = atomic_load_explicit(&queue_info->tail, memory_order_acquire);
+        if (head == queue_info->cached_tail) {
+            *isThereData = 0;
+            return 0;
+        }
+    }
+    *isThereData = 1;
+    uint8_t data = queue_info->queue[head & queue_info->mask];
+    atomic_store_explicit(&queue_info->head, head + 1, memory_order_release);
+    return data;
 }
 
+/*
+    Goal of Function:
+    Dequeue up to amount bytes into data. Consumer thread only.
+    Returns the amount of bytes copied out
+*/
+uint32_t spscDequeueChunk(spsc_queue_t *queue_info, uint8_t *data, uint32_t amount) {
+    uint32_t head = atomic_load_explicit(&queue_info->head, memory_order_relaxed);
+    if ((queue_info->cached_tail - head) < amount) {
+        queue_info->cached_tail = atomic_load_explicit(&queue_info->tail, memory_order_acquire);
+    }
+    uint32_t available = queue_info->cached_tail - head;
+    if (amount > available) {
+        amount = available;
+    }
+    if (amount == 0) {
+        return 0;
+    }
+    uint32_t index = head & queue_info->mask;
+    uint32_t first = queue_info->max_capacity - index;
+    if (first > amount) {
+        first = amount;
+    }
+    memcpy(data, &queue_info->queue[index], first);
+    memcpy(data + first, queue_info->queue, amount - first);
+    atomic_store_explicit(&queue_info->head, head + amount, memory_order_release);
+    return amount;
+}
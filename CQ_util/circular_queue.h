@@ -8,6 +8,63 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <pthread.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+
+//  Queue Misc.
+#define QUEUE_CACHE_LINE_SIZE               (64)
+#define QUEUE_RECORD_HEADER_SIZE            (sizeof(uint32_t))      //  Length prefix of a record
+#define QUEUE_HIST_BUCKETS                  (40)                    //  Residency histogram buckets, bucket i counts [2^i, 2^(i+1)) ns
+#define QUEUE_HIST_MARKS                    (64)                    //  Enqueue timestamps in flight for the residency histogram
+#define QUEUE_SPILL_SEGMENT_SIZE            (16 * 1024 * 1024)      //  Spill file grows and is released in segments of this size
+
+//  Queue Init Flags
+#define QUEUE_FLAG_MIRRORED                 (0x01)          //  Storage mapped twice back to back, spans never wrap
+#define QUEUE_FLAG_LATENCY_HIST             (0x02)          //  Track enqueue to dequeue residency time histogram
+
+//  Queue Overflow Policies (part of the init flags)
+#define QUEUE_POLICY_DROP_NEW               (0x00)          //  Reject data that does not fit (default)
+#define QUEUE_POLICY_OVERWRITE              (0x10)          //  Discard the oldest data to make room
+#define QUEUE_POLICY_BLOCK                  (0x20)          //  Wait for space up to the block timeout, then drop
+#define QUEUE_POLICY_MASK                   (0x30)
+#define QUEUE_DEFAULT_BLOCK_TIMEOUT_US      (100000)
+
+//  Queue Statistics Struct
+typedef struct _queue_stats_t {
+    uint64_t enqueued_bytes;
+    uint64_t dequeued_bytes;
+    uint64_t dropped_bytes;
+    uint64_t overwritten_bytes;
+    uint64_t overflow_events;
+    uint64_t spilled_bytes;
+    uint64_t spill_pending;
+    uint32_t high_water;
+    uint32_t size;
+    uint32_t max_capacity;
+    uint64_t residency_hist[QUEUE_HIST_BUCKETS];
+} queue_stats_t, *p_queue_stats_t;
+
+//  Enqueue timestamp of the byte at a stream offset, used for the residency histogram
+typedef struct _queue_mark_t {
+    uint64_t offset;
+    uint64_t ns;
+} queue_mark_t, *p_queue_mark_t;
+
+//  Disk Spill Struct
+typedef struct _queue_spill_t {
+    int32_t fd;
+    uint8_t *map;
+    uint64_t map_size;
+    uint64_t write_off;
+    uint64_t read_off;
+    uint64_t punched_off;
+    uint32_t threshold;
+} queue_spill_t, *p_queue_spill_t;
 
 //  Circular Queue Struct
 typedef struct _circular_queue_t {
@@ -15,17 +72,72 @@ typedef struct _circular_queue_t {
     uint32_t front;
     uint32_t rear;
     uint32_t size;
+    uint32_t flags;
+    uint32_t wake_threshold;
+    uint32_t waiters;
+    uint32_t space_waiters;
+    uint64_t block_timeout_us;
+    queue_stats_t stats;
+    queue_mark_t *marks;
+    uint32_t mark_head;
+    uint32_t mark_count;
+    queue_spill_t *spill;
     pthread_mutex_t queueLock;
     pthread_cond_t queueCond;
+    pthread_cond_t spaceCond;
     uint8_t *queue;
 } circular_queue_t, *p_circular_queue_t;
 
+//  Contiguous regions of the queue storage, the second region is only used when the data wraps
+typedef struct _queue_span_t {
+    uint8_t *data[2];
+    uint32_t len[2];
+} queue_span_t, *p_queue_span_t;
+
+//  Single Producer Single Consumer Queue Struct
+//  head is only written by the consumer and tail only by the producer, each on its own cache line
+#pragma pack(push, 8)
+typedef struct _spsc_queue_t {
+    _Atomic uint32_t head;
+    uint32_t cached_tail;
+    uint8_t head_pad[QUEUE_CACHE_LINE_SIZE - (2 * sizeof(uint32_t))];
+    _Atomic uint32_t tail;
+    uint32_t cached_head;
+    uint8_t tail_pad[QUEUE_CACHE_LINE_SIZE - (2 * sizeof(uint32_t))];
+    uint32_t max_capacity;
+    uint32_t mask;
+    uint8_t *queue;
+} spsc_queue_t, *p_spsc_queue_t;
+#pragma pack(pop)
+
 //  Declare Functions
 circular_queue_t *queueInit(uint32_t capacity);
+circular_queue_t *queueInitFlags(uint32_t capacity, uint32_t flags);
 void queueDestroy(circular_queue_t *queue);
 void enqueue(circular_queue_t *queue, uint8_t data);
 void enqueueChunk(circular_queue_t *queue_info, uint8_t *data, uint32_t amount);
 uint8_t dequeue(circular_queue_t *queue_info, uint8_t *isThereData);
 uint8_t *dequeueChunk(circular_queue_t *queue_info, uint32_t *amount);
+uint8_t dequeueWait(circular_queue_t *queue_info, uint8_t *isThereData);
+uint8_t *dequeueChunkTimed(circular_queue_t *queue_info, uint32_t *amount, uint32_t secs, uint32_t usecs);
+void queueSetWakeThreshold(circular_queue_t *queue_info, uint32_t threshold);
+void queueSetBlockTimeout(circular_queue_t *queue_info, uint32_t secs, uint32_t usecs);
+uint32_t queueReserve(circular_queue_t *queue_info, queue_span_t *span);
+void queueCommit(circular_queue_t *queue_info, uint32_t amount);
+uint32_t queuePeek(circular_queue_t *queue_info, queue_span_t *span);
+void queueConsume(circular_queue_t *queue_info, uint32_t amount);
+uint8_t enqueueRecord(circular_queue_t *queue_info, const uint8_t *data, uint32_t len);
+int32_t dequeueRecord(circular_queue_t *queue_info, uint8_t *data, uint32_t max_len);
+uint32_t queuePeekRecord(circular_queue_t *queue_info, queue_span_t *span);
+void queueConsumeRecord(circular_queue_t *queue_info);
+void queueGetStats(circular_queue_t *queue_info, queue_stats_t *stats);
+int32_t queueEnableSpill(circular_queue_t *queue_info, const uint8_t *spill_path, uint32_t threshold);
+spsc_queue_t *spscQueueInit(uint32_t capacity);
+void spscQueueDestroy(spsc_queue_t *queue_info);
+uint32_t spscQueueSize(spsc_queue_t *queue_info);
+uint8_t spscEnqueue(spsc_queue_t *queue_info, uint8_t data);
+uint8_t spscEnqueueChunk(spsc_queue_t *queue_info, const uint8_t *data, uint32_t amount);
+uint8_t spscDequeue(spsc_queue_t *queue_info, uint8_t *isThereData);
+uint32_t spscDequeueChunk(spsc_queue_t *queue_info, uint8_t *data, uint32_t amount);
 
 #endif
\ No newline at end of file
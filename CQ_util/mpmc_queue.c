@@ -0,0 +1,131 @@
+//  Developed Libraries
+#include "mpmc_queue.h"
+
+
+static uint8_t errorArray[120] = {0};
+
+//  Slot header, the element bytes follow it
+typedef struct _mpmc_slot_t {
+    _Atomic uint64_t sequence;
+} mpmc_slot_t;
+
+/*
+    Goal of Function:
+    Get the slot for a position
+*/
+static inline mpmc_slot_t *mpmcSlot(mpmc_queue_t *queue_info, uint64_t pos) {
+    return (mpmc_slot_t *) &queue_info->slots[(size_t) (pos & queue_info->mask) * queue_info->slot_size];
+}
+
+/*
+    Goal of Function:
+    Initialize the struct for the multi producer multi consumer queue.
+    capacity: Number of elements, rounded up to a power of two
+    element_size: Size in bytes of one element
+*/
+mpmc_queue_t *mpmcQueueInit(uint32_t capacity, uint32_t element_size) {
+    mpmc_queue_t *queue_info = NULL;
+    if (posix_memalign((void **) &queue_info, QUEUE_CACHE_LINE_SIZE, sizeof(mpmc_queue_t)) != 0) {
+        snprintf(errorArray, sizeof(errorArray), "%s: Error Allocating Queue\n", __FUNCTION__);
+        perror(errorArray);
+        return NULL;
+    }
+    memset(queue_info, 0, sizeof(mpmc_queue_t));
+    uint32_t power = 2;
+    while (power < capacity && power < 0x80000000U) {
+        power <<= 1;
+    }
+    queue_info->max_capacity = power;
+    queue_info->mask = power - 1;
+    queue_info->element_size = element_size;
+    queue_info->slot_size = (sizeof(mpmc_slot_t) + element_size + 7) & ~7U;
+    if (posix_memalign((void **) &queue_info->slots, QUEUE_CACHE_LINE_SIZE, (size_t) power * queue_info->slot_size) != 0) {
+        snprintf(errorArray, sizeof(errorArray), "%s: Error Allocating Queue Slots\n", __FUNCTION__);
+        perror(errorArray);
+        free(queue_info);
+        return NULL;
+    }
+    for (uint32_t i = 0; i < power; i++) {
+        atomic_init(&mpmcSlot(queue_info, i)->sequence, i);
+    }
+    atomic_init(&queue_info->enqueue_pos, 0);
+    atomic_init(&queue_info->dequeue_pos, 0);
+    return queue_info;
+}
+
+/*
+    Goal of Function:
+    Destroy the struct for the multi producer multi consumer queue
+*/
+void mpmcQueueDestroy(mpmc_queue_t *queue_info) {
+    free(queue_info->slots);
+    free(queue_info);
+}
+
+/*
+    Goal of Function:
+    Get the amount of elements currently in the queue (approximate while other threads are running)
+*/
+uint32_t mpmcQueueSize(mpmc_queue_t *queue_info) {
+    uint64_t dequeue_pos = atomic_load_explicit(&queue_info->dequeue_pos, memory_order_acquire);
+    uint64_t enqueue_pos = atomic_load_explicit(&queue_info->enqueue_pos, memory_order_acquire);
+    return (enqueue_pos > dequeue_pos) ? (uint32_t) (enqueue_pos - dequeue_pos) : 0;
+}
+
+/*
+    Goal of Function:
+    Copy one element into the queue. Safe from any number of producer threads.
+    Returns 1 on success and 0 if the queue is full
+*/
+uint8_t mpmcEnqueue(mpmc_queue_t *queue_info, const void *element) {
+    mpmc_slot_t *slot;
+    uint64_t pos = atomic_load_explicit(&queue_info->enqueue_pos, memory_order_relaxed);
+    for (;;) {
+        slot = mpmcSlot(queue_info, pos);
+        uint64_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        int64_t diff = (int64_t) sequence - (int64_t) pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue_info->enqueue_pos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            return 0;
+        }
+        else {
+            pos = atomic_load_explicit(&queue_info->enqueue_pos, memory_order_relaxed);
+        }
+    }
+    memcpy((uint8_t *) slot + sizeof(mpmc_slot_t), element, queue_info->element_size);
+    atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+    return 1;
+}
+
+/*
+    Goal of Function:
+    Copy one element out of the queue. Safe from any number of consumer threads.
+    Returns 1 if an element was copied and 0 if the queue is empty
+*/
+uint8_t mpmcDequeue(mpmc_queue_t *queue_info, void *element) {
+    mpmc_slot_t *slot;
+    uint64_t pos = atomic_load_explicit(&queue_info->dequeue_pos, memory_order_relaxed);
+    for (;;) {
+        slot = mpmcSlot(queue_info, pos);
+        uint64_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        int64_t diff = (int64_t) sequence - (int64_t) (pos + 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue_info->dequeue_pos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            return 0;
+        }
+        else {
+            pos = atomic_load_explicit(&queue_info->dequeue_pos, memory_order_relaxed);
+        }
+    }
+    memcpy(element, (uint8_t *) slot + sizeof(mpmc_slot_t), queue_info->element_size);
+    atomic_store_explicit(&slot->sequence, pos + queue_info->mask + 1, memory_order_release);
+    return 1;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#ifndef MPMC_QUEUE_H
+#define MPMC_QUEUE_H
+
+//  Standard Libraries
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+//  Developed Libraries
+#include "circular_queue.h"
+
+//  Multi Producer Multi Consumer Queue Struct
+//  Every slot holds a sequence number followed by one element. The sequence tells producers and
+//  consumers whose turn the slot is, so the only shared writes are the two position counters
+#pragma pack(push, 8)
+typedef struct _mpmc_queue_t {
+    _Atomic uint64_t enqueue_pos;
+    uint8_t enqueue_pad[QUEUE_CACHE_LINE_SIZE - sizeof(uint64_t)];
+    _Atomic uint64_t dequeue_pos;
+    uint8_t dequeue_pad[QUEUE_CACHE_LINE_SIZE - sizeof(uint64_t)];
+    uint32_t max_capacity;
+    uint32_t mask;
+    uint32_t element_size;
+    uint32_t slot_size;
+    uint8_t *slots;
+} mpmc_queue_t, *p_mpmc_queue_t;
+#pragma pack(pop)
+
+//  Declare a typed wrapper around mpmc_queue_t, e.g. MPMC_QUEUE_DEFINE(msg, msg_t) gives
+//  msgQueueInit(capacity), msgEnqueue(queue, const msg_t *) and msgDequeue(queue, msg_t *)
+#define MPMC_QUEUE_DEFINE(name, type)                                                               \
+    static inline mpmc_queue_t *name##QueueInit(uint32_t capacity) {                                \
+        return mpmcQueueInit(capacity, sizeof(type));                                               \
+    }                                                                                               \
+    static inline uint8_t name##Enqueue(mpmc_queue_t *queue_info, const type *element) {            \
+        return mpmcEnqueue(queue_info, element);                                                    \
+    }                                                                                               \
+    static inline uint8_t name##Dequeue(mpmc_queue_t *queue_info, type *element) {                  \
+        return mpmcDequeue(queue_info, element);                                                    \
+    }
+
+//  Declare Functions
+mpmc_queue_t *mpmcQueueInit(uint32_t capacity, uint32_t element_size);
+void mpmcQueueDestroy(mpmc_queue_t *queue_info);
+uint32_t mpmcQueueSize(mpmc_queue_t *queue_info);
+uint8_t mpmcEnqueue(mpmc_queue_t *queue_info, const void *element);
+uint8_t mpmcDequeue(mpmc_queue_t *queue_info, void *element);
+
+#endif
@@ -0,0 +1,94 @@
+/*
+    Allocation check for the synchronous text logger. malloc, calloc and realloc are
+    interposed and counted on the calling thread while lines are logged. Lines that fit
+    LOG_SCRATCH_SIZE must not allocate, an oversized line must allocate exactly once.
+
+    Build: gcc -O2 -o log_alloc_test log_alloc_test.c log_common.c log_compress.c ../CQ_util/mpmc_queue.c ../CQ_util/circular_queue.c ../UDP_util/UDP_common.c -lpthread
+    Usage: log_alloc_test [lines]
+
+    Returns 0 if both checks pass, 1 otherwise.
+*/
+#define _GNU_SOURCE
+
+//  Developed Libraries
+#include "log_common.h"
+
+//  Definitions
+#define ALLOC_TEST_LINES                    (10000)         //  Default lines logged by the zero allocation check
+#define ALLOC_TEST_PATH                     "/tmp/log_alloc_test.log"
+
+//  glibc Allocator Entry Points
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+//  Global Static Variables
+static __thread uint8_t allocCounting = 0;                                                          //  Only the test thread is counted
+static __thread uint32_t allocCount = 0;
+
+/*
+    Function: Counted allocator entry points, the library and libc resolve to these
+*/
+void *malloc(size_t size) {
+    if (allocCounting) {
+        allocCount++;
+    }
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    if (allocCounting) {
+        allocCount++;
+    }
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    if (allocCounting) {
+        allocCount++;
+    }
+    return __libc_realloc(ptr, size);
+}
+
+int main(int argc, char **argv) {
+    uint32_t lines = (argc > 1) ? (uint32_t) atoi(argv[1]) : ALLOC_TEST_LINES;
+    log_info_t test_log;
+    if (log_str_init(&test_log, (const uint8_t *) ALLOC_TEST_PATH, 0, LOG_INFO) < 0) {
+        return 1;
+    }
+    log_info(&test_log, "warm up %d", 0);                                                           //  First line loads the time zone and thread caches
+
+    int32_t status = 0;
+    allocCount = 0;
+    allocCounting = 1;
+    for (uint32_t i = 0; i < lines; i++) {
+        log_info(&test_log, "line %u of %u value %f tag %s", i, lines, i * 0.5, "alloc");
+    }
+    allocCounting = 0;
+    if (allocCount != 0) {
+        fprintf(stderr, "FAIL: %u lines made %u allocations, expected 0\n", lines, allocCount);
+        status = 1;
+    }
+    else {
+        printf("PASS: %u lines made no allocations\n", lines);
+    }
+
+    uint8_t big[LOG_SCRATCH_SIZE * 2];
+    memset(big, 'x', sizeof(big) - 1);
+    big[sizeof(big) - 1] = '\0';
+    allocCount = 0;
+    allocCounting = 1;
+    log_info(&test_log, "oversized %s", big);
+    allocCounting = 0;
+    if (allocCount != 1) {
+        fprintf(stderr, "FAIL: oversized line made %u allocations, expected 1\n", allocCount);
+        status = 1;
+    }
+    else {
+        printf("PASS: oversized line made one allocation\n");
+    }
+
+    log_close(&test_log);
+    unlink(ALLOC_TEST_PATH);
+    return status;
+}
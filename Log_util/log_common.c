@@ -1,116 +1,1909 @@
+//  Feature Macros
+#define _GNU_SOURCE
+
 //  Developed Libraries
+#include "../CQ_util/circular_queue.h"
+#include "../CQ_util/mpmc_queue.h"
+#include "../UDP_util/UDP_common.h"
 #include "log_common.h"
+#include "log_compress.h"
+#include <sys/resource.h>
+
+/*
+---------------------------------------------------------------------------------
+Private Structs
+---------------------------------------------------------------------------------
+*/
+#pragma pack(push, 8)
+//  One formatted line in the async ring
+typedef struct _log_record_t {
+    uint32_t len;
+    uint8_t text[LOG_ASYNC_RECORD_SIZE];
+} log_record_t;
+
+//  Async Logger State
+typedef struct _log_async_t {
+    mpmc_queue_t *ring;
+    pthread_t writerThread;
+    _Atomic uint8_t running;
+    _Atomic uint64_t dropped;
+    log_record_t batch[LOG_ASYNC_BATCH];
+    struct iovec iov[LOG_ASYNC_BATCH];
+} log_async_t;
+
+//  Binary Logger State
+typedef struct _log_bin_t {
+    _Atomic uint32_t defs_written;
+} log_bin_t;
+
+//  Memory Mapped Sink State
+typedef struct _log_mmap_t {
+    uint8_t *map;                                                                                   //  Page aligned mapping
+    size_t map_len;
+    uint8_t *base;                                                                                  //  First byte of the current segment
+    uint64_t segment;                                                                               //  Writable bytes at base
+    uint64_t file_off;                                                                              //  File offset of base
+    uint8_t broken;                                                                                 //  Mapping failed, fall back to write
+    _Atomic uint64_t offset;                                                                        //  Bytes reserved in the segment
+    _Atomic uint32_t active;                                                                        //  Writers between reserve and copy
+    _Atomic uint32_t generation;                                                                    //  Bumped on every segment switch
+    pthread_mutex_t lock;                                                                           //  Serializes segment switches
+} log_mmap_t;
+
+//  One line with the raw time it was logged at, for ordering
+typedef struct _log_stamped_t {
+    uint64_t ts_ns;
+    log_record_t record;
+} log_stamped_t;
+
+//  One Logging Thread's Staging Buffer
+typedef struct _log_thread_buf_t {
+    mpmc_queue_t *ring;                                                                             //  Written by its thread only, read by the merger
+    pthread_t thread;
+    struct _log_thread_buf_t *next;
+    uint8_t has_pending;                                                                            //  Merger side head of the ring
+    log_stamped_t pending;
+} log_thread_buf_t;
+
+//  Per Thread Buffer Merger State
+typedef struct _log_merge_t {
+    uint64_t id;                                                                                    //  Unique per start, keys the thread caches
+    uint32_t records;
+    _Atomic(log_thread_buf_t *) head;                                                               //  Buffers are only ever pushed to the front
+    pthread_mutex_t lock;                                                                           //  Guards buffer creation
+    pthread_t mergerThread;
+    _Atomic uint8_t running;
+    _Atomic uint64_t dropped;
+    log_record_t batch[LOG_ASYNC_BATCH];
+    struct iovec iov[LOG_ASYNC_BATCH];
+} log_merge_t;
+
+//  Rotated Segment Compressor State
+typedef struct _log_compress_t {
+    pthread_t compressThread;
+    pthread_mutex_t lock;                                                                           //  Held while rotation renames files
+    pthread_cond_t cond;
+    uint8_t running;
+    uint8_t pending;                                                                                //  A rotation happened since the last scan
+} log_compress_t;
+
+//  One Flight Recorder Line, seq is the line number + 1 once the text is complete
+typedef struct _log_flight_slot_t {
+    _Atomic uint64_t seq;
+    uint32_t len;
+    uint8_t text[LOG_FLIGHT_RECORD_SIZE];
+} log_flight_slot_t;
+
+//  Flight Recorder
+typedef struct _log_flight_t {
+    uint32_t records;
+    _Atomic uint64_t head;                                                                          //  Lines ever captured
+    log_flight_slot_t *slots;
+} log_flight_t;
+
+//  One line queued to a sink, with its level for filtering and syslog priority
+typedef struct _log_sink_line_t {
+    uint8_t level;
+    log_record_t record;
+} log_sink_line_t;
+
+//  Fan Out Sink
+typedef struct _log_sink_t {
+    uint8_t type;
+    uint8_t level;                                                                                  //  Highest level this sink takes
+    int32_t fd;                                                                                     //  LOG_SINK_FILE
+    udp_info_t udp;                                                                                 //  LOG_SINK_UDP
+    circular_queue_t *memory;                                                                       //  LOG_SINK_MEMORY
+    mpmc_queue_t *ring;                                                                             //  This sink's own async queue
+    pthread_t writerThread;
+    _Atomic uint8_t running;
+    _Atomic uint64_t dropped;
+    struct _log_sink_t *next;
+    log_sink_line_t batch[LOG_ASYNC_BATCH];
+    struct iovec iov[LOG_ASYNC_BATCH];
+} log_sink_t;
+#pragma pack(pop)
+
+//  Registered Binary Format
+typedef struct _log_bin_def_t {
+    const uint8_t *fmt;
+    uint16_t fmt_len;
+    uint8_t nargs;
+    uint16_t fixed;
+    uint8_t types[LOG_BIN_MAX_ARGS];
+} log_bin_def_t;
+
+//  Global Static Variables
+static uint8_t errorArray[120] = {0};                                                               //  Error array to help print specific function
+static const uint8_t *logLevelNames[] = {                                                           //  Level tags indexed by level
+    "LOG_NONE", "LOG_FATAL", "LOG_ERROR", "LOG_WARN", "LOG_INFO", "LOG_DEBUG", "LOG_DEBUG_EX0", "LOG_DEBUG_EX1"
+};
+static log_info_t *logCrashLog;                                                                     //  Log dumped by the crash handler
+static struct sigaction logCrashOld[NSIG];                                                          //  Handlers chained to after a dump and restored on close
+static const int32_t logCrashSignals[] = { SIGSEGV, SIGABRT, SIGBUS, SIGFPE, SIGILL };
+static pthread_once_t logCrashStackOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t logCrashStackKey;                                                              //  Frees a thread's signal stack when it exits
+static const uint8_t logSyslogSeverity[] = {                                                        //  Syslog severity indexed by level
+    7, 2, 3, 4, 6, 7, 7, 7
+};
+static log_bin_def_t logBinDefs[LOG_BIN_MAX_FORMATS] = {                                            //  Binary format registry indexed by id
+    [LOG_BIN_TEXT_ID] = { "%s", 2, 1, sizeof(uint16_t), { LOG_BIN_ARG_STR } }
+};
+static _Atomic uint32_t logBinDefCount = LOG_BIN_TEXT_ID;                                           //  Highest registered id
+static pthread_mutex_t logBinLock = PTHREAD_MUTEX_INITIALIZER;                                      //  Guards registration and definition writes
+static __thread uint8_t logScratch[LOG_SCRATCH_SIZE];                                               //  Per thread line buffer for synchronous writes
+static __thread uint64_t logMergeCacheId;                                                           //  Merger the cached buffer belongs to
+static __thread log_thread_buf_t *logMergeCacheBuf;                                                 //  This thread's buffer in that merger
+static _Atomic uint64_t logMergeIds;                                                                //  Source of merger ids
+static __thread time_t tsCacheSec = -1;                                                             //  Second the cached date text belongs to
+static __thread uint8_t tsCacheText[20];                                                            //  Cached "YYYY-mm-dd HH:MM:SS"
+static log_limit_t *_Atomic logLimitSites;                                                          //  Rate limited sites that suppressed a line
+
+/*
+    Function: Write a CLOCK_REALTIME time as "YYYY-mm-dd HH:MM:SS[.fraction]". The date text is
+              cached per thread and only rebuilt when the second changes, so most calls are a few
+              digit stores
+    buf: Buffer to write to
+    sz: Size of buffer, LOG_TIMESTAMP_SIZE always fits
+    digits: Fraction digits, 0 - 9
+    now: Time to format
+    Return: Length written, not counting the terminator
+*/
+static size_t log_timestamp_at(uint8_t *buf, size_t sz, uint8_t digits, const struct timespec *now) {
+    if (now->tv_sec != tsCacheSec) {                                                                //  New second, rebuild the date text
+        struct tm tm;
+        localtime_r(&now->tv_sec, &tm);
+        strftime(tsCacheText, sizeof(tsCacheText), "%Y-%m-%d %H:%M:%S", &tm);
+        tsCacheSec = now->tv_sec;
+    }
+    if (digits > LOG_TS_NANO) {
+        digits = LOG_TS_NANO;
+    }
+    size_t len = sizeof(tsCacheText) - 1 + (digits ? digits + 1 : 0);
+    if (sz == 0) {
+        return 0;
+    }
+    if (len >= sz) {                                                                                //  Too small, drop the fraction then truncate
+        digits = 0;
+        len = (sizeof(tsCacheText) - 1 < sz) ? sizeof(tsCacheText) - 1 : sz - 1;
+    }
+    memcpy(buf, tsCacheText, digits ? sizeof(tsCacheText) - 1 : len);
+    if (digits) {
+        uint32_t frac = now->tv_nsec;
+        for (uint8_t i = digits; i < LOG_TS_NANO; i++) {                                            //  Keep the leading digits
+            frac /= 10;
+        }
+        buf[sizeof(tsCacheText) - 1] = '.';
+        for (uint8_t i = digits; i > 0; i--) {
+            buf[sizeof(tsCacheText) - 1 + i] = '0' + frac % 10;
+            frac /= 10;
+        }
+    }
+    buf[len] = 0;
+    return len;
+}
+
+/*
+    Function: Open the log file and start the monitor thread, shared by both init functions
+    log_info: Struct that hold file descriptor and log file information
+    log_path: Path to the log file
+    max_size: Maximum size of log file before it is rotated (0 disables size rotation)
+    log_level: Highest level that is written
+*/
+static int32_t log_file_init(log_info_t *log_info, const uint8_t *log_path, uint64_t max_size, uint8_t log_level) {
+    snprintf(log_info->file_path, sizeof(log_info->file_path), "%s", log_path);                     //  Keep path for rotation
+    if ((log_info->fd = open(log_path, O_RDWR | O_CREAT | O_TRUNC | O_APPEND, 0644)) < 0) {       //  Open file descriptor and clear its contents
+        snprintf(errorArray, sizeof(errorArray), "%s: Open FD\n", __FUNCTION__);                    //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        return -1;                                                                                  //  Return error
+    }
+    log_info->max_size = max_size;                                                                  //  Set maximum size
+    log_info->log_level = log_level;                                                                //  Set log level
+    log_info->max_files = LOG_DEFAULT_MAX_FILES;                                                    //  Set rotated file count
+    log_info->rotate_secs = 0;                                                                      //  No time based rotation
+    log_info->opened_at = time(NULL);                                                               //  Start of the current file
+    log_info->stdout_redirect = 0;                                                                  //  Set by log_print_init
+    log_info->ts_digits = LOG_TS_DEFAULT;                                                           //  Sub second digits on each line
+    log_info->async = NULL;                                                                         //  Synchronous until log_async_start
+    log_info->bin = NULL;                                                                           //  Text until log_bin_start
+    log_info->mmap = NULL;                                                                          //  write() until log_mmap_start
+    log_info->merge = NULL;                                                                         //  Shared path until log_merge_start
+    log_info->sinks = NULL;                                                                         //  No fan out until log_sink_add_*
+    log_info->compress = NULL;                                                                      //  Rotated files stay plain until log_compress_start
+    log_info->flight = NULL;                                                                        //  No flight recorder until log_flight_start
+    log_info->capture_level = 0;
+    log_info->sink_level = 0;
+
+    if (pthread_cond_init(&log_info->monitorCond, NULL) != 0) {                                     //  Initialize thread condition
+        snprintf(errorArray, sizeof(errorArray), "%s: Thread Condition\n", __FUNCTION__);           //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        return -1;                                                                                  //  Return error
+    }
+
+    if (pthread_mutex_init(&log_info->monitorLock, NULL) != 0) {                                    //  Initialize thread lock
+        snprintf(errorArray, sizeof(errorArray), "%s: Thread Lock\n", __FUNCTION__);                //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        return -1;                                                                                  //  Return error
+    }
+
+    if (pthread_mutex_init(&log_info->rotateLock, NULL) != 0) {                                     //  Initialize rotation lock
+        snprintf(errorArray, sizeof(errorArray), "%s: Rotate Lock\n", __FUNCTION__);                //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        return -1;                                                                                  //  Return error
+    }
+
+    log_info->monitorThread_Flag = 1;                                                               //  Set monitor flag high before the thread runs
+    if (pthread_create(&log_info->monitorThread, NULL, monitorFileSize, log_info) != 0) {           //  Create Thread with log_info args
+        log_info->monitorThread_Flag = 0;
+        snprintf(errorArray, sizeof(errorArray), "%s: Thread Create\n", __FUNCTION__);              //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        return -1;                                                                                  //  Return error
+    }
+
+    return 1;                                                                                       //  Return good
+}
+
+/*
+    Function: Initialize log information and thread to send print statements to a file
+    log_info: Struct that hold file descriptor and log file information
+    log_path: Path to the log file
+    max_size: Maximum size of log file
+*/
+int32_t log_print_init(log_info_t *log_info, const uint8_t *log_path, uint64_t max_size, uint8_t log_level) {
+    if (log_file_init(log_info, log_path, max_size, log_level) < 0) {
+        return -1;                                                                                  //  Return error
+    }
+    log_info->stdout_redirect = 1;                                                                  //  Keep stdout on the current file across rotations
+    dup2(log_info->fd, STDOUT_FILENO);
+    return 1;                                                                                       //  Return good
+}
+
+/*
+    Function: Initialize log information and thread to send string to a file
+    log_info: Struct that hold file descriptor and log file information
+    log_path: Path to the log file
+    max_size: Maximum size of log file
+*/
+int32_t log_str_init(log_info_t *log_info, const uint8_t *log_path, uint64_t max_size, uint8_t log_level) {
+    return log_file_init(log_info, log_path, max_size, log_level);
+}
+
+/*
+    Function: Set how rotation keeps old files and whether it also rotates on time
+    log_info: Struct that hold file descriptor and log file information
+    max_files: Number of rotated files kept as path.1 .. path.N (0 just truncates the file)
+    rotate_secs: Rotate after this many seconds even if the size limit was not hit (0 disables)
+*/
+void log_set_rotation(log_info_t *log_info, uint8_t max_files, uint32_t rotate_secs) {
+    pthread_mutex_lock(&log_info->rotateLock);
+    log_info->max_files = max_files;
+    log_info->rotate_secs = rotate_secs;
+    pthread_mutex_unlock(&log_info->rotateLock);
+    pthread_mutex_lock(&log_info->monitorLock);
+    pthread_cond_signal(&log_info->monitorCond);                                                    //  Let the monitor pick up the new interval
+    pthread_mutex_unlock(&log_info->monitorLock);
+}
+
+/*
+    Function: Parse a printf format into the argument types a binary record has to store
+    fmt: Format string
+    def: Registry entry to fill
+    Return: 1 if every conversion can be deferred, 0 otherwise (%n, %m, wide strings, too many args)
+*/
+static int32_t log_bin_parse(const uint8_t *fmt, log_bin_def_t *def) {
+    static const uint8_t argSizes[] = {
+        0, sizeof(int), sizeof(long), sizeof(long long), sizeof(size_t), sizeof(double), sizeof(long double), sizeof(uint16_t), sizeof(void *)
+    };
+    def->nargs = 0;
+    def->fixed = 0;
+    for (const uint8_t *p = fmt; *p; p++) {
+        if (*p != '%') {
+            continue;
+        }
+        if (*++p == '%') {
+            continue;
+        }
+        while (*p && strchr("-+ #0'", *p)) {                                                        //  Flags
+            p++;
+        }
+        for (int32_t field = 0; field < 2; field++) {                                               //  Width then precision
+            if (field == 1) {
+                if (*p != '.') {
+                    break;
+                }
+                p++;
+            }
+            if (*p == '*') {
+                if (def->nargs >= LOG_BIN_MAX_ARGS) {
+                    return 0;
+                }
+                def->types[def->nargs++] = LOG_BIN_ARG_INT;
+                p++;
+            }
+            while (*p >= '0' && *p <= '9') {
+                p++;
+            }
+        }
+        uint8_t length = 0;                                                                         //  Length modifier
+        while (*p && strchr("hlLqjzt", *p)) {
+            length = (length == 'l' && *p == 'l') ? 'q' : *p;
+            p++;
+        }
+        uint8_t type;
+        if (*p && strchr("diouxXc", *p)) {
+            if (length == 'l' && *p != 'c') {
+                type = LOG_BIN_ARG_LONG;
+            } else if (length == 'q' || length == 'L' || length == 'j') {
+                type = LOG_BIN_ARG_LLONG;
+            } else if (length == 'z' || length == 't') {
+                type = LOG_BIN_ARG_SIZE;
+            } else {
+                type = LOG_BIN_ARG_INT;
+            }
+        } else if (*p && strchr("eEfFgGaA", *p)) {
+            type = (length == 'L') ? LOG_BIN_ARG_LDOUBLE : LOG_BIN_ARG_DOUBLE;
+        } else if (*p == 's' && length == 0) {
+            type = LOG_BIN_ARG_STR;
+        } else if (*p == 'p') {
+            type = LOG_BIN_ARG_PTR;
+        } else {
+            return 0;                                                                               //  Needs the caller's state or is malformed
+        }
+        if (def->nargs >= LOG_BIN_MAX_ARGS) {
+            return 0;
+        }
+        def->types[def->nargs++] = type;
+    }
+    for (uint8_t i = 0; i < def->nargs; i++) {
+        def->fixed += argSizes[def->types[i]];
+    }
+    return 1;
+}
+
+/*
+    Function: Write format definition records to a file descriptor. Caller holds logBinLock
+    fd: File descriptor to write to
+    first: First id to write
+    last: Last id to write
+*/
+static void log_bin_write_defs(int32_t fd, uint32_t first, uint32_t last) {
+    uint8_t buf[sizeof(log_bin_format_t) + LOG_BIN_MAX_FORMAT_LEN];
+    for (uint32_t id = first; id <= last; id++) {
+        log_bin_format_t *rec = (log_bin_format_t *) buf;
+        log_bin_def_t *def = &logBinDefs[id];
+        rec->type = LOG_BIN_REC_FORMAT;
+        rec->len = sizeof(log_bin_format_t) + def->fmt_len;
+        rec->id = id;
+        rec->nargs = def->nargs;
+        memcpy(rec->types, def->types, sizeof(rec->types));
+        memcpy(buf + sizeof(log_bin_format_t), def->fmt, def->fmt_len);
+        if (write(fd, buf, rec->len) != rec->len) {
+            snprintf(errorArray, sizeof(errorArray), "%s: write\n", __FUNCTION__);                  //  Populate Error Array
+            perror(errorArray);                                                                     //  Print out this if it failed
+            return;
+        }
+    }
+}
+
+/*
+    Function: Start a binary file with the magic and every format registered so far, so each
+              rotated file decodes on its own. Caller holds logBinLock
+    log_info: Struct that hold file descriptor and log file information
+    fd: File descriptor of the new file
+*/
+static void log_bin_preamble(log_info_t *log_info, int32_t fd) {
+    uint32_t count = atomic_load_explicit(&logBinDefCount, memory_order_acquire);
+    if (write(fd, LOG_BIN_MAGIC, LOG_BIN_MAGIC_SIZE) != LOG_BIN_MAGIC_SIZE) {
+        snprintf(errorArray, sizeof(errorArray), "%s: write\n", __FUNCTION__);                      //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        return;
+    }
+    log_bin_write_defs(fd, 1, count);
+    atomic_store_explicit(&log_info->bin->defs_written, count, memory_order_release);
+}
+
+/*
+    Function: Set how many sub second digits each text line timestamp carries
+    log_info: Struct that hold file descriptor and log file information
+    digits: LOG_TS_SECONDS, LOG_TS_MILLI, LOG_TS_MICRO or LOG_TS_NANO (any 0 - 9 works)
+*/
+void log_set_timestamp_precision(log_info_t *log_info, uint8_t digits) {
+    log_info->ts_digits = (digits > LOG_TS_NANO) ? LOG_TS_NANO : digits;
+}
+
+/*
+    Function: Rotate the log file. path.N-1 -> path.N ... path -> path.1 and a fresh file is
+              swapped in under the same fd with dup2, so writers never see a closed fd.
+              Cost is a few renames no matter how big the file is. Caller holds rotateLock
+    log_info: Struct that hold file descriptor and log file information
+*/
+static void log_rotate(log_info_t *log_info) {
+    uint8_t from[LOG_PATH_SIZE + 16];
+    uint8_t to[LOG_PATH_SIZE + 16];
+    if (log_info->max_files == 0) {                                                                 //  No history kept, start over in place
+        ftruncate(log_info->fd, 0);
+        if (log_info->bin != NULL) {
+            pthread_mutex_lock(&logBinLock);
+            log_bin_preamble(log_info, log_info->fd);
+            pthread_mutex_unlock(&logBinLock);
+        }
+        log_info->opened_at = time(NULL);
+        return;
+    }
+    if (log_info->compress != NULL) {                                                               //  Compressor matches files by name after this
+        pthread_mutex_lock(&log_info->compress->lock);
+    }
+    snprintf(to, sizeof(to), "%s.%d", log_info->file_path, log_info->max_files);                    //  Oldest slot may hold either form
+    unlink(to);
+    snprintf(to, sizeof(to), "%s.%d" LOG_LZ_EXTENSION, log_info->file_path, log_info->max_files);
+    unlink(to);
+    for (int32_t i = log_info->max_files - 1; i >= 1; i--) {                                        //  Shift older files up, the last one is replaced
+        snprintf(from, sizeof(from), "%s.%d", log_info->file_path, i);
+        snprintf(to, sizeof(to), "%s.%d", log_info->file_path, i + 1);
+        rename(from, to);
+        snprintf(from, sizeof(from), "%s.%d" LOG_LZ_EXTENSION, log_info->file_path, i);
+        snprintf(to, sizeof(to), "%s.%d" LOG_LZ_EXTENSION, log_info->file_path, i + 1);
+        rename(from, to);
+    }
+    snprintf(to, sizeof(to), "%s.1", log_info->file_path);
+    rename(log_info->file_path, to);
+    if (log_info->compress != NULL) {                                                               //  Hand path.1 to the compressor
+        log_info->compress->pending = 1;
+        pthread_cond_signal(&log_info->compress->cond);
+        pthread_mutex_unlock(&log_info->compress->lock);
+    }
+    int32_t fd = open(log_info->file_path, O_RDWR | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (fd < 0) {
+        snprintf(errorArray, sizeof(errorArray), "%s: Open FD\n", __FUNCTION__);                    //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        return;                                                                                     //  Keep writing to the renamed file
+    }
+    if (log_info->bin != NULL) {                                                                    //  New binary file has to describe itself first
+        pthread_mutex_lock(&logBinLock);
+        log_bin_preamble(log_info, fd);
+    }
+    dup2(fd, log_info->fd);                                                                         //  Atomically point the log fd at the new file
+    if (log_info->bin != NULL) {
+        pthread_mutex_unlock(&logBinLock);
+    }
+    if (log_info->stdout_redirect) {
+        dup2(fd, STDOUT_FILENO);
+    }
+    close(fd);
+    log_info->opened_at = time(NULL);
+}
+
+/*
+    Function: Size the file for a new segment at file_off and map it. Caller holds the mmap lock
+              with no writers inside the old segment
+    log_info: Struct that hold file descriptor and log file information
+    Return: 1 on success, -1 on error (the sink falls back to write)
+*/
+static int32_t log_mmap_map(log_info_t *log_info) {
+    log_mmap_t *m = log_info->mmap;
+    uint64_t page = sysconf(_SC_PAGESIZE);
+    uint64_t map_off = m->file_off & ~(page - 1);                                                   //  mmap offsets have to be page aligned
+    m->map_len = (m->file_off - map_off) + m->segment;
+    if (ftruncate(log_info->fd, m->file_off + m->segment) != 0 ||
+        (m->map = mmap(NULL, m->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, log_info->fd, map_off)) == MAP_FAILED) {
+        snprintf(errorArray, sizeof(errorArray), "%s: mmap\n", __FUNCTION__);                       //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        ftruncate(log_info->fd, m->file_off);
+        m->map = NULL;
+        m->base = NULL;
+        m->broken = 1;
+        return -1;                                                                                  //  Return error
+    }
+    m->base = m->map + (m->file_off - map_off);
+    m->broken = 0;
+    return 1;                                                                                       //  Return good
+}
+
+/*
+    Function: Close the current segment and map the next one. Stops new reservations, waits for
+              writers still copying, trims the file to the bytes used, rotates if asked, then maps a
+              fresh segment after the used bytes. Only the monitor rotates, under rotateLock, a
+              writer that fills the file past max_size wakes it instead
+    log_info: Struct that hold file descriptor and log file information
+    generation: Segment the caller saw as full, nothing is done if another thread already switched
+    rotate: Rotate the file, the caller holds rotateLock
+*/
+static void log_mmap_roll(log_info_t *log_info, uint32_t generation, uint8_t rotate) {
+    log_mmap_t *m = log_info->mmap;
+    pthread_mutex_lock(&m->lock);
+    if (atomic_load(&m->generation) != generation) {                                                //  Someone else switched already
+        pthread_mutex_unlock(&m->lock);
+        return;
+    }
+    uint64_t used = atomic_exchange(&m->offset, LOG_MMAP_CLOSED);                                   //  Stop new reservations
+    while (atomic_load(&m->active) != 0) {                                                          //  Let in-flight copies finish
+        sched_yield();
+    }
+    if (used != LOG_MMAP_CLOSED) {
+        m->file_off += used;
+    }
+    if (m->map != NULL) {
+        munmap(m->map, m->map_len);
+        m->map = NULL;
+    }
+    ftruncate(log_info->fd, m->file_off);                                                           //  Drop the unused tail
+    if (rotate) {
+        log_rotate(log_info);
+        m->file_off = 0;
+    }
+    uint8_t full = (log_info->max_size > 0 && m->file_off >= log_info->max_size);
+    log_mmap_map(log_info);
+    atomic_store(&m->offset, 0);
+    atomic_fetch_add(&m->generation, 1);
+    pthread_mutex_unlock(&m->lock);
+    if (full) {                                                                                     //  Rotation is due, let the monitor do it
+        pthread_mutex_lock(&log_info->monitorLock);
+        pthread_cond_signal(&log_info->monitorCond);
+        pthread_mutex_unlock(&log_info->monitorLock);
+    }
+}
+
+/*
+    Function: Append bytes to a file, short writes are retried so a line is never cut
+    fd: File descriptor
+    buf: Bytes to write
+    len: Number of bytes
+*/
+static void log_write_fd(int32_t fd, const uint8_t *buf, size_t len) {
+    while (len > 0) {
+        ssize_t written = write(fd, buf, len);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            snprintf(errorArray, sizeof(errorArray), "%s: write\n", __FUNCTION__);                  //  Populate Error Array
+            perror(errorArray);                                                                     //  Print out this if it failed
+            return;
+        }
+        buf += written;
+        len -= written;
+    }
+}
+
+/*
+    Function: Write a set of buffers with writev, a short write advances the iovecs and retries
+              the rest so a batch is never cut mid line. The iovecs are modified
+    fd: File descriptor
+    iov: Buffers to write
+    count: Number of buffers
+*/
+static void log_writev_fd(int32_t fd, struct iovec *iov, uint32_t count) {
+    while (count > 0) {
+        ssize_t written = writev(fd, iov, count);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            snprintf(errorArray, sizeof(errorArray), "%s: writev\n", __FUNCTION__);                 //  Populate Error Array
+            perror(errorArray);                                                                     //  Print out this if it failed
+            return;
+        }
+        while (count > 0 && (size_t) written >= iov->iov_len) {                                     //  Skip the buffers that went out whole
+            written -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (uint8_t *) iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+}
+
+/*
+    Function: Copy one record into the mapped segment. The offset is claimed with a CAS so the
+              common case is a memcpy with no syscall, a full segment switches to the next one.
+              Without a mapping the bytes are written instead but still claimed the same way, so
+              the monitor sees the size, rotation happens and every full segment retries the map
+    log_info: Struct that hold file descriptor and log file information
+    buf: Bytes to append
+    len: Number of bytes
+*/
+static void log_mmap_append(log_info_t *log_info, const uint8_t *buf, size_t len) {
+    log_mmap_t *m = log_info->mmap;
+    if (len > m->segment) {                                                                         //  A record never spans segments
+        len = m->segment;
+    }
+    for (;;) {
+        uint32_t generation = atomic_load(&m->generation);
+        atomic_fetch_add(&m->active, 1);
+        uint64_t cur = atomic_load(&m->offset);
+        while (cur != LOG_MMAP_CLOSED && cur + len <= m->segment) {
+            if (atomic_compare_exchange_weak(&m->offset, &cur, cur + len)) {
+                if (m->broken) {                                                                    //  No mapping, the roll waits for this write
+                    log_write_fd(log_info->fd, buf, len);
+                }
+                else {
+                    memcpy(m->base + cur, buf, len);
+                }
+                atomic_fetch_sub_explicit(&m->active, 1, memory_order_release);
+                return;
+            }
+        }
+        atomic_fetch_sub(&m->active, 1);
+        log_mmap_roll(log_info, generation, 0);                                                     //  Segment full or switching
+    }
+}
+
+/*
+    Function: Write finished bytes to the log, through the mapping in mmap mode
+    log_info: Struct that hold file descriptor and log file information
+    buf: Bytes to write
+    len: Number of bytes
+*/
+static void log_emit(log_info_t *log_info, const uint8_t *buf, size_t len) {
+    if (log_info->mmap != NULL) {
+        log_mmap_append(log_info, buf, len);
+        return;
+    }
+    log_write_fd(log_info->fd, buf, len);
+}
+
+/*
+    Function: Run thread that will monitor file size and age and rotate the file
+    args: Arguements as a pointer
+*/
+void *monitorFileSize(void *args) {
+    p_log_info_t p_info = (p_log_info_t) args;                                                      //  Create pointer to log info struct
+    pthread_mutex_lock(&p_info->monitorLock);                                                       //  Lock monitor
+    while (p_info->monitorThread_Flag) {                                                            //  While monitor flag is high
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += 1;                                                                       //  Wake at least once a second for time rotation
+        pthread_cond_timedwait(&p_info->monitorCond, &p_info->monitorLock, &deadline);              //  Thread waits here until signal or timeout
+        if (!p_info->monitorThread_Flag) {
+            break;
+        }
+        pthread_mutex_unlock(&p_info->monitorLock);                                                 //  Writers take it to signal, keep them out of the renames
+        pthread_mutex_lock(&p_info->rotateLock);
+        time_t now = time(NULL);
+        struct stat st;
+        if (p_info->mmap != NULL) {                                                                 //  File size is the mapped size, use the used bytes
+            log_mmap_t *m = p_info->mmap;
+            pthread_mutex_lock(&m->lock);                                                           //  file_off only changes under the segment lock
+            uint32_t generation = atomic_load(&m->generation);
+            uint64_t used = atomic_load(&m->offset);
+            uint64_t size = m->file_off + (used == LOG_MMAP_CLOSED ? 0 : used);
+            pthread_mutex_unlock(&m->lock);
+            if ((p_info->max_size > 0 && size >= p_info->max_size) ||
+                (p_info->rotate_secs > 0 && size > 0 && (now - p_info->opened_at) >= p_info->rotate_secs)) {
+                log_mmap_roll(p_info, generation, 1);
+            }
+        }
+        else if (fstat(p_info->fd, &st) == 0 &&
+                 ((p_info->max_size > 0 && (uint64_t) st.st_size >= p_info->max_size) ||
+                  (p_info->rotate_secs > 0 && st.st_size > 0 && (now - p_info->opened_at) >= p_info->rotate_secs))) {
+            log_rotate(p_info);
+        }
+        pthread_mutex_unlock(&p_info->rotateLock);
+        pthread_mutex_lock(&p_info->monitorLock);
+    }
+    pthread_mutex_unlock(&p_info->monitorLock);                                                     //  Unlock monitor
+    pthread_exit(NULL);                                                                             //  Close Thread
+}
+
+/*
+    Function: Find or create the calling thread's staging buffer. The result is cached per thread
+              so only a thread's first line takes the lock
+    merge: Merger state
+    Return: The buffer, NULL if it could not be allocated
+*/
+static log_thread_buf_t *log_merge_buffer(log_merge_t *merge) {
+    if (logMergeCacheId == merge->id) {
+        return logMergeCacheBuf;
+    }
+    pthread_t self = pthread_self();
+    pthread_mutex_lock(&merge->lock);
+    log_thread_buf_t *buf = atomic_load(&merge->head);
+    while (buf != NULL && !pthread_equal(buf->thread, self)) {
+        buf = buf->next;
+    }
+    if (buf == NULL && (buf = calloc(1, sizeof(log_thread_buf_t))) != NULL) {
+        if ((buf->ring = mpmcQueueInit(merge->records, sizeof(log_stamped_t))) == NULL) {
+            free(buf);
+            buf = NULL;
+        } else {
+            buf->thread = self;
+            buf->next = atomic_load(&merge->head);
+            atomic_store_explicit(&merge->head, buf, memory_order_release);                         //  Publish to the merger
+        }
+    }
+    pthread_mutex_unlock(&merge->lock);
+    if (buf != NULL) {
+        logMergeCacheId = merge->id;
+        logMergeCacheBuf = buf;
+    }
+    return buf;
+}
+
+/*
+    Function: Stage one line in the calling thread's buffer. Never blocks, the line is counted as
+              dropped if the buffer is full
+    log_info: Struct that hold file descriptor and log file information
+    stamped: Line and the raw time it was logged at
+*/
+static void log_merge_push(log_info_t *log_info, const log_stamped_t *stamped) {
+    log_thread_buf_t *buf = log_merge_buffer(log_info->merge);
+    if (buf == NULL || !mpmcEnqueue(buf->ring, stamped)) {
+        atomic_fetch_add_explicit(&log_info->merge->dropped, 1, memory_order_relaxed);
+    }
+}
+
+/*
+    Function: Fill a record with an already formatted line as a binary text event
+    record: Record to fill
+    level: Log level of the line
+    msg: Formatted message
+*/
+static void log_bin_text_record(log_record_t *record, uint8_t level, const uint8_t *msg) {
+    log_bin_event_t *event = (log_bin_event_t *) record->text;
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    uint16_t len = strnlen(msg, sizeof(record->text) - sizeof(log_bin_event_t) - sizeof(uint16_t));
+    event->type = LOG_BIN_REC_EVENT;
+    event->id = LOG_BIN_TEXT_ID;
+    event->level = level;
+    event->ts_ns = (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+    memcpy(record->text + sizeof(log_bin_event_t), &len, sizeof(len));
+    memcpy(record->text + sizeof(log_bin_event_t) + sizeof(len), msg, len);
+    event->len = sizeof(log_bin_event_t) + sizeof(len) + len;
+    record->len = event->len;
+}
+
+/*
+    Function: Hand a finished binary record to the async ring or write it straight out
+    log_info: Struct that hold file descriptor and log file information
+    record: Record to write
+*/
+static void log_bin_commit(log_info_t *log_info, log_record_t *record) {
+    if (log_info->merge != NULL) {                                                                  //  Stage under the event's own time
+        log_stamped_t stamped;
+        stamped.ts_ns = ((log_bin_event_t *) record->text)->ts_ns;
+        memcpy(&stamped.record, record, sizeof(uint32_t) + record->len);
+        log_merge_push(log_info, &stamped);
+        return;
+    }
+    if (log_info->async != NULL) {
+        if (!mpmcEnqueue(log_info->async->ring, record)) {                                          //  Ring full, drop instead of waiting
+            atomic_fetch_add_explicit(&log_info->async->dropped, 1, memory_order_relaxed);
+        }
+        return;
+    }
+    if (write(log_info->fd, record->text, record->len) < 0) {                                       //  One append per record keeps records whole
+        snprintf(errorArray, sizeof(errorArray), "%s: write\n", __FUNCTION__);                      //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+    }
+}
+
+/*
+    Function: Format a full "[ts] LEVEL: msg\n" line into a buffer
+    buf: Buffer to format into
+    sz: Size of the buffer
+    level: Log level of the line
+    ts: Timestamp string
+    fmt: orignal string
+    ap: arguements to the string
+    Return: Length of the full line like snprintf, so a value >= sz means it was truncated
+*/
+static int32_t log_format_line(uint8_t *buf, size_t sz, uint8_t level, const uint8_t *ts, const uint8_t *fmt, va_list ap) {
+    int32_t len = snprintf(buf, sz, "[%s] %s: ", ts, logLevelNames[level]);                         //  Prefix
+    if (len < 0 || (size_t) len >= sz) {
+        return -1;
+    }
+    int32_t msg_len = vsnprintf(buf + len, sz - len, fmt, ap);
+    if (msg_len < 0) {
+        return -1;
+    }
+    len += msg_len;
+    if ((size_t) len + 1 < sz) {                                                                    //  Room for the newline and terminator
+        buf[len] = '\n';
+        buf[len + 1] = 0;
+    }
+    return len + 1;
+}
+
+/*
+    Function: Format a line once and queue it to every sink that takes its level. Never blocks,
+              a full sink queue only drops lines for that sink
+    log_info: Struct that hold file descriptor and log file information
+    level: Log level of the line
+    fmt: orignal string
+    ap: arguements to the string
+*/
+static void log_sink_fanout(log_info_t *log_info, uint8_t level, const uint8_t *fmt, va_list ap) {
+    log_sink_t *sink = log_info->sinks;
+    while (sink != NULL && sink->level < level) {                                                   //  Skip formatting if no sink wants it
+        sink = sink->next;
+    }
+    if (sink == NULL) {
+        return;
+    }
+    log_sink_line_t line;
+    uint8_t ts[LOG_TIMESTAMP_SIZE];
+    log_timestamp(ts, sizeof(ts), log_info->ts_digits);
+    int32_t len = log_format_line(line.record.text, sizeof(line.record.text), level, ts, fmt, ap);
+    if (len < 0) {
+        return;
+    }
+    if (len >= (int32_t) sizeof(line.record.text)) {                                                //  Truncated to the record size
+        len = sizeof(line.record.text) - 1;
+        line.record.text[len - 1] = '\n';
+    }
+    line.record.len = len;
+    line.level = level;
+    for (; sink != NULL; sink = sink->next) {
+        if (sink->level >= level && !mpmcEnqueue(sink->ring, &line)) {                              //  Sink full, drop for this sink only
+            atomic_fetch_add_explicit(&sink->dropped, 1, memory_order_relaxed);
+        }
+    }
+}
+
+/*
+    Function: Keep one line in the flight recorder. Slots are claimed with an atomic counter and
+              marked complete with their line number, so a dump from a signal handler can skip a
+              slot that is half written
+    log_info: Struct that hold file descriptor and log file information
+    level: Log level of the line
+    fmt: orignal string
+    ap: arguements to the string
+*/
+static void log_flight_capture(log_info_t *log_info, uint8_t level, const uint8_t *fmt, va_list ap) {
+    log_flight_t *flight = log_info->flight;
+    uint8_t ts[LOG_TIMESTAMP_SIZE];
+    log_timestamp(ts, sizeof(ts), log_info->ts_digits);
+    uint64_t line = atomic_fetch_add_explicit(&flight->head, 1, memory_order_relaxed);
+    log_flight_slot_t *slot = &flight->slots[line % flight->records];
+    atomic_store_explicit(&slot->seq, 0, memory_order_relaxed);                                     //  Not complete while we write it
+    atomic_thread_fence(memory_order_release);
+    int32_t len = log_format_line(slot->text, sizeof(slot->text), level, ts, fmt, ap);
+    if (len < 0) {
+        return;
+    }
+    if (len >= (int32_t) sizeof(slot->text)) {                                                      //  Truncated to the slot size
+        len = sizeof(slot->text) - 1;
+        slot->text[len - 1] = '\n';
+    }
+    slot->len = len;
+    atomic_store_explicit(&slot->seq, line + 1, memory_order_release);
+}
+
+/*
+    Function: Format one line into an async record and push it to the ring. Never blocks,
+              the line is counted as dropped if the ring is full
+    log_info: Struct that hold file descriptor and log file information
+    level: Log level of the line
+    ts: Timestamp string
+    fmt: orignal string
+    ap: arguements to the string
+*/
+static void log_async_push(log_info_t *log_info, uint8_t level, const uint8_t *ts, const uint8_t *fmt, va_list ap) {
+    log_async_t *async = log_info->async;
+    log_record_t record;
+    int32_t len = log_format_line(record.text, sizeof(record.text), level, ts, fmt, ap);
+    if (len < 0) {
+        return;
+    }
+    if (len >= (int32_t) sizeof(record.text)) {                                                     //  Truncated to the record size
+        len = sizeof(record.text) - 1;
+        record.text[len - 1] = '\n';
+    }
+    record.len = len;
+    if (!mpmcEnqueue(async->ring, &record)) {                                                       //  Ring full, drop instead of waiting
+        atomic_fetch_add_explicit(&async->dropped, 1, memory_order_relaxed);
+    }
+}
+
+/*
+    Function: Write one log line for any level
+    log_info: Struct that hold file descriptor and log file information
+    level: Log level of the line
+    fmt: orignal string
+    ap: arguements to the string
+*/
+static void log_write(log_info_t *log_info, uint8_t level, const uint8_t *fmt, va_list ap) {
+    if (log_info->flight != NULL && level <= log_info->capture_level) {                             //  Flight recorder keeps filtered levels too
+        va_list ap_copy;
+        va_copy(ap_copy, ap);
+        log_flight_capture(log_info, level, fmt, ap_copy);
+        va_end(ap_copy);
+    }
+    if (log_info->sinks != NULL && level <= log_info->sink_level) {                                 //  Fan out before the primary path uses ap
+        va_list ap_copy;
+        va_copy(ap_copy, ap);
+        log_sink_fanout(log_info, level, fmt, ap_copy);
+        va_end(ap_copy);
+    }
+    if (level > log_info->log_level) {                                                              //  Only wanted by a sink or the flight recorder
+        return;
+    }
+    if (log_info->merge != NULL) {                                                                  //  Register before stamping so the merger waits on us
+        log_merge_buffer(log_info->merge);
+    }
+    if (log_info->bin != NULL) {                                                                    //  Binary mode, text lines become text events
+        uint8_t msg[LOG_ASYNC_RECORD_SIZE];
+        log_record_t record;
+        vsnprintf(msg, sizeof(msg), fmt, ap);
+        log_bin_text_record(&record, level, msg);
+        log_bin_commit(log_info, &record);
+        return;
+    }
+    uint8_t ts[LOG_TIMESTAMP_SIZE];
+    if (log_info->merge != NULL) {                                                                  //  Per thread buffers, ordered by the merger
+        log_stamped_t stamped;
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        log_timestamp_at(ts, sizeof(ts), log_info->ts_digits, &now);
+        int32_t len = log_format_line(stamped.record.text, sizeof(stamped.record.text), level, ts, fmt, ap);
+        if (len < 0) {
+            return;
+        }
+        if (len >= (int32_t) sizeof(stamped.record.text)) {                                         //  Truncated to the record size
+            len = sizeof(stamped.record.text) - 1;
+            stamped.record.text[len - 1] = '\n';
+        }
+        stamped.record.len = len;
+        stamped.ts_ns = (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+        log_merge_push(log_info, &stamped);
+        return;
+    }
+    log_timestamp(ts, sizeof(ts), log_info->ts_digits);
+    if (log_info->async != NULL) {                                                                  //  Async mode, no I/O on the caller
+        log_async_push(log_info, level, ts, fmt, ap);
+        return;
+    }
+    va_list ap_copy;
+    va_copy(ap_copy, ap);
+    int32_t len = log_format_line(logScratch, sizeof(logScratch), level, ts, fmt, ap_copy);         //  Per thread scratch, no allocation
+    va_end(ap_copy);
+    if (len < 0) {
+        return;
+    }
+    uint8_t *line = logScratch;
+    if (len >= (int32_t) sizeof(logScratch)) {                                                      //  Oversized line, heap fallback
+        if ((line = malloc(len + 1)) == NULL) {
+            return;
+        }
+        log_format_line(line, len + 1, level, ts, fmt, ap);
+    }
+    log_emit(log_info, line, len);
+    if (line != logScratch) {
+        free(line);
+    }
+    if (log_info->mmap != NULL) {                                                                   //  Monitor polls the mapped size on its own
+        return;
+    }
+    pthread_mutex_lock(&log_info->monitorLock);
+    pthread_cond_signal(&log_info->monitorCond);
+    pthread_mutex_unlock(&log_info->monitorLock);
+}
+
+/*
+    Function: Fill a record with a warning about lines lost to full buffers
+    log_info: Struct that hold file descriptor and log file information
+    record: Record to fill
+    dropped: Number of lines lost
+*/
+static void log_drop_record(log_info_t *log_info, log_record_t *record, uint64_t dropped) {
+    if (log_info->bin != NULL) {
+        uint8_t msg[64];
+        snprintf(msg, sizeof(msg), "%llu async log lines dropped", (unsigned long long) dropped);
+        log_bin_text_record(record, LOG_WARN, msg);
+        return;
+    }
+    uint8_t ts[LOG_TIMESTAMP_SIZE];
+    log_timestamp(ts, sizeof(ts), log_info->ts_digits);
+    record->len = snprintf(record->text, sizeof(record->text), "[%s] %s: %llu async log lines dropped\n",
+                           ts, logLevelNames[LOG_WARN], (unsigned long long) dropped);
+}
+
+/*
+    Function: Write a batch of lines from a background writer and let the monitor check the file
+    log_info: Struct that hold file descriptor and log file information
+    iov: Lines to write
+    count: Number of lines
+*/
+static void log_write_batch(log_info_t *log_info, struct iovec *iov, uint32_t count) {
+    if (log_info->mmap != NULL) {                                                                   //  Mapped, copy without syscalls
+        for (uint32_t i = 0; i < count; i++) {
+            log_mmap_append(log_info, iov[i].iov_base, iov[i].iov_len);
+        }
+        return;
+    }
+    log_writev_fd(log_info->fd, iov, count);                                                        //  One syscall per batch unless it comes up short
+    pthread_mutex_lock(&log_info->monitorLock);                                                     //  Let the monitor check the file once per batch
+    pthread_cond_signal(&log_info->monitorCond);
+    pthread_mutex_unlock(&log_info->monitorLock);
+}
+
+/*
+    Function: Run thread that drains the async ring and writes lines in writev batches
+    args: Arguements as a pointer
+*/
+static void *log_async_writer(void *args) {
+    p_log_info_t p_info = (p_log_info_t) args;                                                      //  Create pointer to log info struct
+    log_async_t *async = p_info->async;
+    uint64_t reported = 0;                                                                          //  Dropped count already reported
+    for (;;) {
+        uint32_t count = 0;
+        while (count < LOG_ASYNC_BATCH && mpmcDequeue(async->ring, &async->batch[count])) {         //  Collect a batch
+            async->iov[count].iov_base = async->batch[count].text;
+            async->iov[count].iov_len = async->batch[count].len;
+            count++;
+        }
+        uint64_t dropped = atomic_load_explicit(&async->dropped, memory_order_relaxed);
+        if (dropped != reported && count < LOG_ASYNC_BATCH) {                                       //  Report lines lost to a full ring
+            log_drop_record(p_info, &async->batch[count], dropped - reported);
+            async->iov[count].iov_base = async->batch[count].text;
+            async->iov[count].iov_len = async->batch[count].len;
+            count++;
+            reported = dropped;
+        }
+        if (count == 0) {
+            if (!atomic_load_explicit(&async->running, memory_order_acquire)) {                     //  Stopped and drained
+                break;
+            }
+            usleep(LOG_ASYNC_IDLE_US);                                                              //  Idle, producers never signal
+            continue;
+        }
+        log_write_batch(p_info, async->iov, count);
+    }
+    pthread_exit(NULL);                                                                             //  Close Thread
+}
+
+/*
+    Function: Run thread that merges the per thread buffers into one file ordered by timestamp.
+              The oldest head across all buffers is written next. While some thread has nothing
+              staged the merger holds back lines newer than LOG_MERGE_GRACE_US, since that thread
+              may still be about to stage an older one
+    args: Arguements as a pointer
+*/
+static void *log_merge_writer(void *args) {
+    p_log_info_t p_info = (p_log_info_t) args;                                                      //  Create pointer to log info struct
+    log_merge_t *merge = p_info->merge;
+    uint64_t reported = 0;                                                                          //  Dropped count already reported
+    uint32_t count = 0;
+    for (;;) {
+        uint8_t running = atomic_load_explicit(&merge->running, memory_order_acquire);
+        uint8_t complete = 1;                                                                       //  Every buffer has a staged head
+        log_thread_buf_t *oldest = NULL;
+        for (log_thread_buf_t *buf = atomic_load_explicit(&merge->head, memory_order_acquire); buf != NULL; buf = buf->next) {
+            if (!buf->has_pending) {
+                buf->has_pending = mpmcDequeue(buf->ring, &buf->pending);
+            }
+            if (!buf->has_pending) {
+                complete = 0;
+            } else if (oldest == NULL || buf->pending.ts_ns < oldest->pending.ts_ns) {
+                oldest = buf;
+            }
+        }
+        uint8_t ready = (oldest != NULL);
+        if (ready && !complete && running) {                                                        //  Wait for quiet threads within the grace window
+            struct timespec now;
+            clock_gettime(CLOCK_REALTIME, &now);
+            uint64_t now_ns = (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+            ready = (oldest->pending.ts_ns + LOG_MERGE_GRACE_US * 1000ULL <= now_ns);
+        }
+        if (ready) {
+            memcpy(&merge->batch[count], &oldest->pending.record, sizeof(uint32_t) + oldest->pending.record.len);
+            merge->iov[count].iov_base = merge->batch[count].text;
+            merge->iov[count].iov_len = merge->batch[count].len;
+            oldest->has_pending = 0;
+            if (++count < LOG_ASYNC_BATCH) {
+                continue;
+            }
+        }
+        uint64_t dropped = atomic_load_explicit(&merge->dropped, memory_order_relaxed);
+        if (dropped != reported && count < LOG_ASYNC_BATCH) {                                       //  Report lines lost to full buffers
+            log_drop_record(p_info, &merge->batch[count], dropped - reported);
+            merge->iov[count].iov_base = merge->batch[count].text;
+            merge->iov[count].iov_len = merge->batch[count].len;
+            count++;
+            reported = dropped;
+        }
+        if (count > 0) {
+            log_write_batch(p_info, merge->iov, count);
+            count = 0;
+        }
+        if (!ready) {
+            if (oldest == NULL && !running) {                                                       //  Stopped and drained
+                break;
+            }
+            usleep(LOG_ASYNC_IDLE_US);                                                              //  Idle, producers never signal
+        }
+    }
+    pthread_exit(NULL);                                                                             //  Close Thread
+}
+
+/*
+    Function: Switch the log to async mode. Log calls then only format into a lock-free ring
+              and a background thread writes the ring out in batches
+    log_info: Struct that hold file descriptor and log file information
+    records: Ring size in records (0 uses LOG_ASYNC_DEFAULT_RECORDS)
+*/
+int32_t log_async_start(log_info_t *log_info, uint32_t records) {
+    if (log_info->async != NULL) {                                                                  //  Already async
+        return 1;
+    }
+    if (log_info->merge != NULL) {
+        snprintf(errorArray, sizeof(errorArray), "%s: Per thread buffers active\n", __FUNCTION__);  //  Populate Error Array
+        errno = EINVAL;
+        perror(errorArray);                                                                         //  Print out this if it failed
+        return -1;                                                                                  //  Return error
+    }
+    log_async_t *async = calloc(1, sizeof(log_async_t));
+    if (async == NULL) {
+        snprintf(errorArray, sizeof(errorArray), "%s: Allocate Async State\n", __FUNCTION__);       //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        return -1;                                                                                  //  Return error
+    }
+    if ((async->ring = mpmcQueueInit(records ? records : LOG_ASYNC_DEFAULT_RECORDS, sizeof(log_record_t))) == NULL) {
+        free(async);
+        return -1;                                                                                  //  Return error
+    }
+    atomic_init(&async->running, 1);
+    atomic_init(&async->dropped, 0);
+    log_info->async = async;
+    if (pthread_create(&async->writerThread, NULL, log_async_writer, log_info) != 0) {              //  Create writer thread
+        snprintf(errorArray, sizeof(errorArray), "%s: Thread Create\n", __FUNCTION__);              //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        log_info->async = NULL;
+        mpmcQueueDestroy(async->ring);
+        free(async);
+        return -1;                                                                                  //  Return error
+    }
+    return 1;                                                                                       //  Return good
+}
+
+/*
+    Function: Switch the log to binary mode. Call right after init, the file is restarted with the
+              binary header. Use log_decode to turn the file back into text. Not available for
+              mapped logs or logs set up by log_print_init
+    log_info: Struct that hold file descriptor and log file information
+*/
+int32_t log_bin_start(log_info_t *log_info) {
+    if (log_info->bin != NULL) {                                                                    //  Already binary
+        return 1;
+    }
+    if (log_info->mmap != NULL || log_info->stdout_redirect) {                                      //  Binary records would land in the printf stream
+        snprintf(errorArray, sizeof(errorArray), "%s: Mmap or stdout log\n", __FUNCTION__);         //  Populate Error Array
+        errno = EINVAL;
+        perror(errorArray);                                                                         //  Print out this if it failed
+        return -1;                                                                                  //  Return error
+    }
+    log_bin_t *bin = calloc(1, sizeof(log_bin_t));
+    if (bin == NULL) {
+        snprintf(errorArray, sizeof(errorArray), "%s: Allocate Binary State\n", __FUNCTION__);      //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        return -1;                                                                                  //  Return error
+    }
+    atomic_init(&bin->defs_written, 0);
+    pthread_mutex_lock(&log_info->rotateLock);                                                      //  Keep rotation out while the file restarts
+    pthread_mutex_lock(&logBinLock);
+    ftruncate(log_info->fd, 0);
+    log_info->bin = bin;
+    log_bin_preamble(log_info, log_info->fd);
+    pthread_mutex_unlock(&logBinLock);
+    pthread_mutex_unlock(&log_info->rotateLock);
+    return 1;                                                                                       //  Return good
+}
+
+/*
+    Function: Register a format string for binary logging, done once per call site by LOG_BIN
+    fmt: Format string, must stay valid for the life of the process (a string literal)
+    site_id: Call site id to publish the result to
+    Return: Format id, or LOG_BIN_UNSUPPORTED when the call site has to format as text
+*/
+uint32_t log_bin_register(const uint8_t *fmt, _Atomic uint32_t *site_id) {
+    pthread_mutex_lock(&logBinLock);
+    uint32_t id = atomic_load_explicit(site_id, memory_order_acquire);
+    if (id != 0) {                                                                                  //  Another thread got here first
+        pthread_mutex_unlock(&logBinLock);
+        return id;
+    }
+    id = atomic_load_explicit(&logBinDefCount, memory_order_relaxed) + 1;
+    size_t fmt_len = strlen(fmt);
+    if (id >= LOG_BIN_MAX_FORMATS || fmt_len > LOG_BIN_MAX_FORMAT_LEN || !log_bin_parse(fmt, &logBinDefs[id])) {
+        id = LOG_BIN_UNSUPPORTED;
+    } else {
+        logBinDefs[id].fmt = fmt;
+        logBinDefs[id].fmt_len = fmt_len;
+        atomic_store_explicit(&logBinDefCount, id, memory_order_release);
+    }
+    atomic_store_explicit(site_id, id, memory_order_release);
+    pthread_mutex_unlock(&logBinLock);
+    return id;
+}
+
+/*
+    Function: Store one binary event. Only the id, a raw timestamp and the raw arguments are
+              written, the formatting happens later in log_decode
+    log_info: Struct that hold file descriptor and log file information
+    level: Log level of the line
+    id: Format id from log_bin_register
+    fmt: Format string, used when the line has to be formatted as text
+    ...: arguements to the string
+*/
+void log_bin_write(log_info_t *log_info, uint8_t level, uint32_t id, const uint8_t *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    if (log_info->bin == NULL || id == 0 || id >= LOG_BIN_MAX_FORMATS || level > log_info->log_level) {  //  Text fallback, filtered lines only reach sinks and the flight recorder
+        log_write(log_info, level, fmt, ap);
+        va_end(ap);
+        return;
+    }
+    if (id > atomic_load_explicit(&log_info->bin->defs_written, memory_order_acquire)) {            //  Definition not in this file yet
+        pthread_mutex_lock(&logBinLock);
+        uint32_t written = atomic_load_explicit(&log_info->bin->defs_written, memory_order_relaxed);
+        uint32_t count = atomic_load_explicit(&logBinDefCount, memory_order_relaxed);
+        if (count > written) {
+            log_bin_write_defs(log_info->fd, written + 1, count);
+            atomic_store_explicit(&log_info->bin->defs_written, count, memory_order_release);
+        }
+        pthread_mutex_unlock(&logBinLock);
+    }
+    if (log_info->merge != NULL) {                                                                  //  Register before stamping so the merger waits on us
+        log_merge_buffer(log_info->merge);
+    }
+    if (log_info->flight != NULL && level <= log_info->capture_level) {                             //  Flight recorder keeps text, formatted here
+        va_list ap_copy;
+        va_copy(ap_copy, ap);
+        log_flight_capture(log_info, level, fmt, ap_copy);
+        va_end(ap_copy);
+    }
+    if (log_info->sinks != NULL && level <= log_info->sink_level) {                                 //  Sinks take text, formatted here
+        va_list ap_copy;
+        va_copy(ap_copy, ap);
+        log_sink_fanout(log_info, level, fmt, ap_copy);
+        va_end(ap_copy);
+    }
+    log_record_t record;
+    log_bin_event_t *event = (log_bin_event_t *) record.text;
+    const log_bin_def_t *def = &logBinDefs[id];
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    event->type = LOG_BIN_REC_EVENT;
+    event->id = id;
+    event->level = level;
+    event->ts_ns = (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+    uint8_t *pos = record.text + sizeof(log_bin_event_t);
+    uint8_t *end = record.text + sizeof(record.text);
+    uint16_t reserve = def->fixed;                                                                  //  Bytes still owed to the fixed size arguments
+#define LOG_BIN_STORE(type) { type v = va_arg(ap, type); memcpy(pos, &v, sizeof(v)); pos += sizeof(v); reserve -= sizeof(v); break; }
+    for (uint8_t i = 0; i < def->nargs; i++) {
+        switch (def->types[i]) {
+            case LOG_BIN_ARG_INT: LOG_BIN_STORE(int);
+            case LOG_BIN_ARG_LONG: LOG_BIN_STORE(long);
+            case LOG_BIN_ARG_LLONG: LOG_BIN_STORE(long long);
+            case LOG_BIN_ARG_SIZE: LOG_BIN_STORE(size_t);
+            case LOG_BIN_ARG_DOUBLE: LOG_BIN_STORE(double);
+            case LOG_BIN_ARG_LDOUBLE: LOG_BIN_STORE(long double);
+            case LOG_BIN_ARG_PTR: LOG_BIN_STORE(void *);
+            case LOG_BIN_ARG_STR: {
+                const uint8_t *str = va_arg(ap, const uint8_t *);
+                reserve -= sizeof(uint16_t);
+                if (str == NULL) {
+                    str = "(null)";
+                }
+                uint16_t len = strnlen(str, end - pos - sizeof(uint16_t) - reserve);                //  Truncate so the record still fits
+                memcpy(pos, &len, sizeof(len));
+                memcpy(pos + sizeof(len), str, len);
+                pos += sizeof(len) + len;
+                break;
+            }
+        }
+    }
+#undef LOG_BIN_STORE
+    va_end(ap);
+    event->len = pos - record.text;
+    record.len = event->len;
+    log_bin_commit(log_info, &record);
+}
+
+/*
+    Function: Switch the log to a memory mapped sink. Lines are copied into a mapped segment of
+              the file with no write syscall, the file is grown one segment at a time and trimmed
+              to the used bytes on every switch, rotation and close. Data is in the page cache as
+              soon as it is copied so it survives a process crash, the file then ends with zero
+              padding up to the segment end. Not available together with binary mode or
+              log_print_init, which both write to the fd directly
+    log_info: Struct that hold file descriptor and log file information
+    segment_size: Bytes mapped at a time (0 uses LOG_MMAP_DEFAULT_SEGMENT)
+*/
+int32_t log_mmap_start(log_info_t *log_info, uint64_t segment_size) {
+    if (log_info->mmap != NULL) {                                                                   //  Already mapped
+        return 1;
+    }
+    if (log_info->bin != NULL || log_info->stdout_redirect) {
+        snprintf(errorArray, sizeof(errorArray), "%s: Binary or stdout log\n", __FUNCTION__);       //  Populate Error Array
+        errno = EINVAL;
+        perror(errorArray);                                                                         //  Print out this if it failed
+        return -1;                                                                                  //  Return error
+    }
+    log_mmap_t *m = calloc(1, sizeof(log_mmap_t));
+    if (m == NULL) {
+        snprintf(errorArray, sizeof(errorArray), "%s: Allocate Mmap State\n", __FUNCTION__);        //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        return -1;                                                                                  //  Return error
+    }
+    uint64_t page = sysconf(_SC_PAGESIZE);
+    segment_size = segment_size ? segment_size : LOG_MMAP_DEFAULT_SEGMENT;
+    segment_size = (segment_size < LOG_MMAP_MIN_SEGMENT) ? LOG_MMAP_MIN_SEGMENT : segment_size;
+    m->segment = (segment_size + page - 1) & ~(page - 1);
+    struct stat st;
+    m->file_off = (fstat(log_info->fd, &st) == 0) ? st.st_size : 0;                                 //  Keep lines already written
+    atomic_init(&m->offset, 0);
+    atomic_init(&m->active, 0);
+    atomic_init(&m->generation, 0);
+    pthread_mutex_init(&m->lock, NULL);
+    pthread_mutex_lock(&log_info->rotateLock);                                                      //  Keep rotation out while switching
+    log_info->mmap = m;
+    if (log_mmap_map(log_info) < 0) {
+        log_info->mmap = NULL;
+        pthread_mutex_unlock(&log_info->rotateLock);
+        pthread_mutex_destroy(&m->lock);
+        free(m);
+        return -1;                                                                                  //  Return error
+    }
+    pthread_mutex_unlock(&log_info->rotateLock);
+    return 1;                                                                                       //  Return good
+}
+
+/*
+    Function: Give every logging thread its own staging buffer, merged into the file by a
+              background thread in timestamp order. Threads never share a ring, lock or cache line
+              on the logging path. Buffers are kept until log_close, so a log used by short lived
+              threads holds one buffer per thread it has seen
+    log_info: Struct that hold file descriptor and log file information
+    records: Per thread buffer size in records (0 uses LOG_MERGE_DEFAULT_RECORDS)
+*/
+int32_t log_merge_start(log_info_t *log_info, uint32_t records) {
+    if (log_info->merge != NULL) {                                                                  //  Already merging
+        return 1;
+    }
+    if (log_info->async != NULL) {
+        snprintf(errorArray, sizeof(errorArray), "%s: Async log active\n", __FUNCTION__);           //  Populate Error Array
+        errno = EINVAL;
+        perror(errorArray);                                                                         //  Print out this if it failed
+        return -1;                                                                                  //  Return error
+    }
+    log_merge_t *merge = calloc(1, sizeof(log_merge_t));
+    if (merge == NULL) {
+        snprintf(errorArray, sizeof(errorArray), "%s: Allocate Merge State\n", __FUNCTION__);       //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        return -1;                                                                                  //  Return error
+    }
+    merge->id = atomic_fetch_add(&logMergeIds, 1) + 1;
+    merge->records = records ? records : LOG_MERGE_DEFAULT_RECORDS;
+    atomic_init(&merge->head, NULL);
+    atomic_init(&merge->running, 1);
+    atomic_init(&merge->dropped, 0);
+    pthread_mutex_init(&merge->lock, NULL);
+    log_info->merge = merge;
+    if (pthread_create(&merge->mergerThread, NULL, log_merge_writer, log_info) != 0) {              //  Create merger thread
+        snprintf(errorArray, sizeof(errorArray), "%s: Thread Create\n", __FUNCTION__);              //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        log_info->merge = NULL;
+        pthread_mutex_destroy(&merge->lock);
+        free(merge);
+        return -1;                                                                                  //  Return error
+    }
+    return 1;                                                                                       //  Return good
+}
 
-//  Global Static Variables
-static uint8_t errorArray[120] = {0};                                                               //  Error array to help print specific function
+/*
+    Function: Hand a batch of lines to a sink's target
+    sink: Sink to deliver to
+    count: Number of lines in the sink batch
+*/
+static void log_sink_deliver(log_sink_t *sink, uint32_t count) {
+    if (sink->type == LOG_SINK_FILE) {
+        for (uint32_t i = 0; i < count; i++) {
+            sink->iov[i].iov_base = sink->batch[i].record.text;
+            sink->iov[i].iov_len = sink->batch[i].record.len;
+        }
+        log_writev_fd(sink->fd, sink->iov, count);                                                  //  One syscall per batch unless it comes up short
+        return;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        log_record_t *record = &sink->batch[i].record;
+        if (sink->type == LOG_SINK_MEMORY) {                                                        //  Ring drops its oldest lines when full
+            enqueueRecord(sink->memory, record->text, record->len);
+            continue;
+        }
+        uint8_t datagram[LOG_ASYNC_RECORD_SIZE + 8];
+        int32_t len = snprintf(datagram, sizeof(datagram), "<%u>", LOG_SYSLOG_FACILITY * 8 + logSyslogSeverity[sink->batch[i].level]);
+        memcpy(datagram + len, record->text, record->len - 1);                                      //  Datagram carries the line without its newline
+        send(sink->udp.socket_fd, datagram, len + record->len - 1, MSG_DONTWAIT);                   //  Best effort, a missing collector must not flood stderr
+    }
+}
 
 /*
-    Function: Initialize log information and thread to send print statements to a file
+    Function: Run thread that drains one sink's queue, so a slow sink only falls behind itself
+    args: Sink as a pointer
+*/
+static void *log_sink_writer(void *args) {
+    log_sink_t *sink = (log_sink_t *) args;
+    uint64_t reported = 0;                                                                          //  Dropped count already reported
+    for (;;) {
+        uint32_t count = 0;
+        while (count < LOG_ASYNC_BATCH && mpmcDequeue(sink->ring, &sink->batch[count])) {           //  Collect a batch
+            count++;
+        }
+        uint64_t dropped = atomic_load_explicit(&sink->dropped, memory_order_relaxed);
+        if (dropped != reported && count < LOG_ASYNC_BATCH) {                                       //  Report lines lost to a full queue
+            uint8_t ts[LOG_TIMESTAMP_SIZE];
+            log_timestamp(ts, sizeof(ts), LOG_TS_DEFAULT);
+            sink->batch[count].level = LOG_WARN;
+            sink->batch[count].record.len = snprintf(sink->batch[count].record.text, sizeof(sink->batch[count].record.text),
+                                                     "[%s] %s: %llu sink log lines dropped\n", ts, logLevelNames[LOG_WARN],
+                                                     (unsigned long long) (dropped - reported));
+            count++;
+            reported = dropped;
+        }
+        if (count == 0) {
+            if (!atomic_load_explicit(&sink->running, memory_order_acquire)) {                      //  Stopped and drained
+                break;
+            }
+            usleep(LOG_ASYNC_IDLE_US);                                                              //  Idle, producers never signal
+            continue;
+        }
+        log_sink_deliver(sink, count);
+    }
+    pthread_exit(NULL);                                                                             //  Close Thread
+}
+
+/*
+    Function: Release a sink's target, queue and memory
+    sink: Sink to free
+*/
+static void log_sink_free(log_sink_t *sink) {
+    if (sink->type == LOG_SINK_FILE && sink->fd >= 0) {
+        close(sink->fd);
+    } else if (sink->type == LOG_SINK_UDP && sink->udp.socket_fd >= 0) {
+        UDP_close(&sink->udp);
+    } else if (sink->type == LOG_SINK_MEMORY && sink->memory != NULL) {
+        queueDestroy(sink->memory);
+    }
+    if (sink->ring != NULL) {
+        mpmcQueueDestroy(sink->ring);
+    }
+    free(sink);
+}
+
+/*
+    Function: Allocate a sink with its queue
+    type: LOG_SINK_FILE, LOG_SINK_UDP or LOG_SINK_MEMORY
+    level: Highest level the sink takes
+    Return: The sink, NULL on error
+*/
+static log_sink_t *log_sink_create(uint8_t type, uint8_t level) {
+    log_sink_t *sink = calloc(1, sizeof(log_sink_t));
+    if (sink == NULL) {
+        snprintf(errorArray, sizeof(errorArray), "%s: Allocate Sink\n", __FUNCTION__);              //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        return NULL;
+    }
+    sink->type = type;
+    sink->level = level;
+    sink->fd = -1;
+    sink->udp.socket_fd = -1;
+    atomic_init(&sink->running, 1);
+    atomic_init(&sink->dropped, 0);
+    if ((sink->ring = mpmcQueueInit(LOG_SINK_DEFAULT_RECORDS, sizeof(log_sink_line_t))) == NULL) {
+        free(sink);
+        return NULL;
+    }
+    return sink;
+}
+
+/*
+    Function: Start a sink's writer and add it to the log. Sinks should be added before other
+              threads start logging
     log_info: Struct that hold file descriptor and log file information
-    log_path: Path to the log file
-    max_size: Maximum size of log file
+    sink: Sink with its target opened
 */
-int32_t log_print_init(log_info_t *log_info, const uint8_t *log_path, uint16_t max_size, uint8_t log_level) {
-    FILE *file = fopen(log_path, "w");                                                              //  Open file clear its contents
-    fclose(file);                                                                                   //  Close file
-    if ((log_info->fd = open(log_path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644)) < 0) {       //  Open file descriptor
-        snprintf(errorArray, sizeof(errorArray), "%s: Open FD\n", __FUNCTION__);                    //  Populate Error Array
+static int32_t log_sink_start(log_info_t *log_info, log_sink_t *sink) {
+    if (pthread_create(&sink->writerThread, NULL, log_sink_writer, sink) != 0) {                    //  Create writer thread
+        snprintf(errorArray, sizeof(errorArray), "%s: Thread Create\n", __FUNCTION__);              //  Populate Error Array
         perror(errorArray);                                                                         //  Print out this if it failed
+        log_sink_free(sink);
         return -1;                                                                                  //  Return error
     }
-    log_info->max_size = max_size;                                                                  //  Set maximum size
-    log_info->log_level = log_level;                                                                //  Set log level
-    dup2(log_info->fd, STDOUT_FILENO);
+    sink->next = log_info->sinks;
+    log_info->sinks = sink;
+    if (sink->level > log_info->sink_level) {                                                       //  Level gates let the sink's lines through
+        log_info->sink_level = sink->level;
+    }
+    return 1;                                                                                       //  Return good
+}
 
-    if (pthread_cond_init(&log_info->monitorCond, NULL) != 0) {                                     //  Initialize thread condition
-        snprintf(errorArray, sizeof(errorArray), "%s: Thread Condition\n", __FUNCTION__);           //  Populate Error Array
+/*
+    Function: Add another log file that gets every line up to level
+    log_info: Struct that hold file descriptor and log file information
+    path: Path to the file, appended to
+    level: Highest level the sink takes
+*/
+int32_t log_sink_add_file(log_info_t *log_info, const uint8_t *path, uint8_t level) {
+    log_sink_t *sink = log_sink_create(LOG_SINK_FILE, level);
+    if (sink == NULL) {
+        return -1;                                                                                  //  Return error
+    }
+    if ((sink->fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644)) < 0) {                         //  Open file descriptor
+        snprintf(errorArray, sizeof(errorArray), "%s: Open FD\n", __FUNCTION__);                    //  Populate Error Array
         perror(errorArray);                                                                         //  Print out this if it failed
+        log_sink_free(sink);
         return -1;                                                                                  //  Return error
     }
+    return log_sink_start(log_info, sink);
+}
 
-    if (pthread_mutex_init(&log_info->monitorLock, NULL) != 0) {                                    //  Initialize thread lock
-        snprintf(errorArray, sizeof(errorArray), "%s: Thread Lock\n", __FUNCTION__);                //  Populate Error Array
-        perror(errorArray);                                                                         //  Print out this if it failed
+/*
+    Function: Add a UDP target that gets every line up to level as a syslog style "<PRI>line"
+              datagram
+    log_info: Struct that hold file descriptor and log file information
+    ip: Collector IPv4 address
+    port: Collector port (514 for syslog)
+    level: Highest level the sink takes
+*/
+int32_t log_sink_add_udp(log_info_t *log_info, const uint8_t *ip, uint16_t port, uint8_t level) {
+    log_sink_t *sink = log_sink_create(LOG_SINK_UDP, level);
+    if (sink == NULL) {
+        return -1;                                                                                  //  Return error
+    }
+    if (UDP_client_init(&sink->udp, ip, port) < 0) {
+        log_sink_free(sink);
         return -1;                                                                                  //  Return error
     }
+    return log_sink_start(log_info, sink);
+}
 
-    if (pthread_create(&log_info->monitorThread, NULL, monitorFileSize, &log_info) < 0) {           //  Create Thread with log_info args
-        snprintf(errorArray, sizeof(errorArray), "%s: Thread Create\n", __FUNCTION__);              //  Populate Error Array
-        perror(errorArray);                                                                         //  Print out this if it failed
+/*
+    Function: Add an in memory ring that keeps the newest lines up to level, for crash dumps
+    log_info: Struct that hold file descriptor and log file information
+    bytes: Ring size, rounded up to a power of two
+    level: Highest level the sink takes
+*/
+int32_t log_sink_add_memory(log_info_t *log_info, uint32_t bytes, uint8_t level) {
+    log_sink_t *sink = log_sink_create(LOG_SINK_MEMORY, level);
+    if (sink == NULL) {
+        return -1;                                                                                  //  Return error
+    }
+    if ((sink->memory = queueInitFlags(bytes, QUEUE_POLICY_OVERWRITE)) == NULL) {                   //  Full ring drops its oldest lines
+        log_sink_free(sink);
         return -1;                                                                                  //  Return error
     }
+    return log_sink_start(log_info, sink);
+}
 
-    return 1;                                                                                       //  Return good
+/*
+    Function: Write out and empty every memory sink, oldest line first
+    log_info: Struct that hold file descriptor and log file information
+    fd: File descriptor to write to
+    Return: Bytes written, -1 on error
+*/
+int64_t log_sink_memory_dump(log_info_t *log_info, int32_t fd) {
+    uint8_t line[LOG_ASYNC_RECORD_SIZE];
+    int64_t total = 0;
+    for (log_sink_t *sink = log_info->sinks; sink != NULL; sink = sink->next) {
+        if (sink->type != LOG_SINK_MEMORY) {
+            continue;
+        }
+        int32_t len;
+        while ((len = dequeueRecord(sink->memory, line, sizeof(line))) > 0) {
+            if (write(fd, line, len) != len) {
+                snprintf(errorArray, sizeof(errorArray), "%s: write\n", __FUNCTION__);              //  Populate Error Array
+                perror(errorArray);                                                                 //  Print out this if it failed
+                return -1;                                                                          //  Return error
+            }
+            total += len;
+        }
+    }
+    return total;
 }
 
 /*
-    Function: Initialize log information and thread to send string to a file
+    Function: Compress one rotated file. The file is read through its own fd, so a rotation
+              renaming it meanwhile is fine, the result is put next to wherever it ended up
     log_info: Struct that hold file descriptor and log file information
-    log_path: Path to the log file
-    max_size: Maximum size of log file
+    path: Rotated file to compress
 */
-int32_t log_str_init(log_info_t *log_info, const uint8_t *log_path, uint16_t max_size, uint8_t log_level) {
-    FILE *file = fopen(log_path, "w");                                                              //  Open file clear its contents
-    fclose(file);                                                                                   //  Close file
-    if ((log_info->fd = open(log_path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644)) < 0) {       //  Open file descriptor
+static void log_compress_file(log_info_t *log_info, const uint8_t *path) {
+    log_compress_t *compress = log_info->compress;
+    uint8_t tmp[LOG_PATH_SIZE + 16];
+    uint8_t name[LOG_PATH_SIZE + 16];
+    struct stat src_st;
+    struct stat st;
+    int32_t in_fd = open(path, O_RDONLY);
+    if (in_fd < 0 || fstat(in_fd, &src_st) != 0) {                                                  //  Rotated away already
+        if (in_fd >= 0) {
+            close(in_fd);
+        }
+        return;
+    }
+    snprintf(tmp, sizeof(tmp), "%s" LOG_LZ_EXTENSION ".tmp", log_info->file_path);
+    int32_t out_fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out_fd < 0) {
         snprintf(errorArray, sizeof(errorArray), "%s: Open FD\n", __FUNCTION__);                    //  Populate Error Array
         perror(errorArray);                                                                         //  Print out this if it failed
-        return -1;                                                                                  //  Return error
+        close(in_fd);
+        return;
     }
-    log_info->max_size = max_size;                                                                  //  Set maximum size
-    log_info->log_level = log_level;                                                                //  Set log level
+    int32_t status = log_lz_compress_fd(in_fd, out_fd);
+    if (status > 0 && fsync(out_fd) != 0) {                                                         //  On disk before the plain copy goes
+        status = -1;
+    }
+    close(out_fd);
+    close(in_fd);
+    uint8_t placed = 0;
+    pthread_mutex_lock(&compress->lock);
+    for (int32_t i = 1; status > 0 && i <= log_info->max_files; i++) {                              //  Find the name the file has now
+        snprintf(name, sizeof(name), "%s.%d", log_info->file_path, i);
+        if (stat(name, &st) == 0 && st.st_ino == src_st.st_ino && st.st_dev == src_st.st_dev) {
+            snprintf(name, sizeof(name), "%s.%d" LOG_LZ_EXTENSION, log_info->file_path, i);
+            if (rename(tmp, name) == 0) {
+                snprintf(name, sizeof(name), "%s.%d", log_info->file_path, i);
+                unlink(name);
+                placed = 1;
+            }
+            break;
+        }
+    }
+    pthread_mutex_unlock(&compress->lock);
+    if (!placed) {                                                                                  //  Failed or rotated out of the kept set
+        unlink(tmp);
+    }
+}
 
-    if (pthread_cond_init(&log_info->monitorCond, NULL) != 0) {                                     //  Initialize thread condition
-        snprintf(errorArray, sizeof(errorArray), "%s: Thread Condition\n", __FUNCTION__);           //  Populate Error Array
-        perror(errorArray);                                                                         //  Print out this if it failed
-        return -1;                                                                                  //  Return error
+/*
+    Function: Run thread that compresses rotated files on idle priority. Every rotation triggers a
+              scan of path.1 .. path.N, so files left plain by an earlier run are picked up too
+    args: Arguements as a pointer
+*/
+static void *log_compress_worker(void *args) {
+    p_log_info_t p_info = (p_log_info_t) args;                                                      //  Create pointer to log info struct
+    log_compress_t *compress = p_info->compress;
+    struct sched_param param = {0};
+    if (pthread_setschedparam(pthread_self(), SCHED_IDLE, &param) != 0) {                           //  Only run when nothing else wants the CPU
+        setpriority(PRIO_PROCESS, gettid(), 19);
+    }
+    uint8_t name[LOG_PATH_SIZE + 16];
+    pthread_mutex_lock(&compress->lock);
+    while (compress->running) {
+        while (compress->running && !compress->pending) {
+            pthread_cond_wait(&compress->cond, &compress->lock);
+        }
+        compress->pending = 0;
+        pthread_mutex_unlock(&compress->lock);
+        for (int32_t i = 1; i <= p_info->max_files; i++) {
+            pthread_mutex_lock(&compress->lock);
+            uint8_t running = compress->running;
+            pthread_mutex_unlock(&compress->lock);
+            if (!running) {
+                break;
+            }
+            snprintf(name, sizeof(name), "%s.%d", p_info->file_path, i);
+            if (access(name, F_OK) == 0) {
+                log_compress_file(p_info, name);
+            }
+        }
+        pthread_mutex_lock(&compress->lock);
     }
+    pthread_mutex_unlock(&compress->lock);
+    pthread_exit(NULL);                                                                             //  Close Thread
+}
 
-    if (pthread_mutex_init(&log_info->monitorLock, NULL) != 0) {                                    //  Initialize thread lock
-        snprintf(errorArray, sizeof(errorArray), "%s: Thread Lock\n", __FUNCTION__);                //  Populate Error Array
+/*
+    Function: Compress rotated files (path.1 .. path.N become path.N.lz) on an idle priority
+              thread. The active file stays plain and logging calls never wait on it. Read the
+              files back with log_decode
+    log_info: Struct that hold file descriptor and log file information
+*/
+int32_t log_compress_start(log_info_t *log_info) {
+    if (log_info->compress != NULL) {                                                               //  Already compressing
+        return 1;
+    }
+    log_compress_t *compress = calloc(1, sizeof(log_compress_t));
+    if (compress == NULL) {
+        snprintf(errorArray, sizeof(errorArray), "%s: Allocate Compress State\n", __FUNCTION__);    //  Populate Error Array
         perror(errorArray);                                                                         //  Print out this if it failed
         return -1;                                                                                  //  Return error
     }
-
-    if (pthread_create(&log_info->monitorThread, NULL, monitorFileSize, &log_info) < 0) {           //  Create Thread with log_info args
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);                                     //  Rotation never waits behind the idle priority thread
+    pthread_mutex_init(&compress->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    pthread_cond_init(&compress->cond, NULL);
+    compress->running = 1;
+    compress->pending = 1;                                                                          //  First scan picks up leftovers
+    pthread_mutex_lock(&log_info->rotateLock);                                                      //  Keep rotation out while publishing
+    log_info->compress = compress;
+    pthread_mutex_unlock(&log_info->rotateLock);
+    if (pthread_create(&compress->compressThread, NULL, log_compress_worker, log_info) != 0) {       //  Create compressor thread
         snprintf(errorArray, sizeof(errorArray), "%s: Thread Create\n", __FUNCTION__);              //  Populate Error Array
         perror(errorArray);                                                                         //  Print out this if it failed
+        pthread_mutex_lock(&log_info->rotateLock);
+        log_info->compress = NULL;
+        pthread_mutex_unlock(&log_info->rotateLock);
+        pthread_cond_destroy(&compress->cond);
+        pthread_mutex_destroy(&compress->lock);
+        free(compress);
         return -1;                                                                                  //  Return error
     }
-
     return 1;                                                                                       //  Return good
 }
 
 /*
-    Function: Run thread that will monitor file size
-    args: Arguements as a pointer
+    Function: Write a number with async signal safe calls only
+    fd: File descriptor to write to
+    value: Number to write
 */
-void *monitorFileSize(void *args) {
-    p_log_info_t p_info = (p_log_info_t) args;                                                      //  Create pointer to log info struct
-    p_info->monitorThread_Flag = 1;                                                                 //  Set monitor flag high
-    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);                                            //  Enable thread cancelation
+static void log_flight_write_number(int32_t fd, uint64_t value) {
+    uint8_t digits[24];
+    uint32_t pos = sizeof(digits);
     do {
-        pthread_mutex_lock(&p_info->monitorLock);                                                   //  Lock monitor
-        pthread_cond_wait(&p_info->monitorCond, &p_info->monitorLock);                              //  Thread waits here until signal is reached
-        pthread_mutex_unlock(&p_info->monitorLock);                                                 //  Unlock monitor
-        struct stat st;
-        if (fstat(p_info->fd, &st) == 0 && st.st_size > p_info->max_size) {
-            off_t start = st.st_size - p_info->max_size;
-            lseek(p_info->fd, start, SEEK_SET);
-            char *buf = malloc(p_info->max_size);
-            ssize_t nr = read(p_info->fd, buf, p_info->max_size);
-            if (nr > 0) {
-                ssize_t off = 0;
-                while (off < nr && buf[off] != '\n') off++;
-                if (off < nr) off++;
-                lseek(p_info->fd, 0, SEEK_SET);
-                write(p_info->fd, buf + off, nr - off);
-                ftruncate(p_info->fd, nr - off);
-            }
-            free(buf);
+        digits[--pos] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+    write(fd, digits + pos, sizeof(digits) - pos);
+}
+
+/*
+    Function: Write the flight recorder, oldest line first. Only uses write, so it is safe to call
+              from a signal handler
+    log_info: Struct that hold file descriptor and log file information
+    fd: File descriptor to write to
+*/
+void log_flight_dump(log_info_t *log_info, int32_t fd) {
+    static const uint8_t header[] = "----- flight recorder: last ";
+    static const uint8_t header_end[] = " lines -----\n";
+    static const uint8_t footer[] = "----- flight recorder end -----\n";
+    log_flight_t *flight = log_info->flight;
+    if (flight == NULL) {
+        return;
+    }
+    uint64_t head = atomic_load_explicit(&flight->head, memory_order_acquire);
+    uint64_t first = (head > flight->records) ? head - flight->records : 0;
+    write(fd, header, sizeof(header) - 1);
+    log_flight_write_number(fd, head - first);
+    write(fd, header_end, sizeof(header_end) - 1);
+    for (uint64_t line = first; line < head; line++) {
+        log_flight_slot_t *slot = &flight->slots[line % flight->records];
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire) == line + 1) {                   //  Skip lines still being written
+            write(fd, slot->text, slot->len);
         }
-    } while (p_info->monitorThread_Flag);                                                           //  While monitor flag is high
-    pthread_exit(NULL);                                                                             //  Close Thread
+    }
+    write(fd, footer, sizeof(footer) - 1);
+}
+
+/*
+    Function: Crash signal handler, dumps the flight recorder then hands the signal to the handler
+              that was installed before log_flight_start. A fault returns and runs again into that
+              handler with its real siginfo, a sent signal is raised again. With no earlier handler
+              the signal kills the process the normal way (core dump included)
+    sig: Signal number
+    info: Signal details
+    context: Interrupted context
+*/
+static void log_crash_handler(int sig, siginfo_t *info, void *context) {
+    (void) context;
+    log_info_t *log_info = logCrashLog;
+    if (log_info != NULL) {
+        log_flight_dump(log_info, (log_info->mmap != NULL) ? STDERR_FILENO : log_info->fd);         //  Mapped files only take appends through the map
+    }
+    sigaction(sig, &logCrashOld[sig], NULL);
+    if (info == NULL || info->si_code <= 0) {                                                       //  Sent by kill, raise or abort, it will not come back
+        raise(sig);                                                                                 //  Blocked until this handler returns
+    }
+}
+
+/*
+    Function: Release a thread's signal stack when the thread exits
+    stack: Stack memory
+*/
+static void log_flight_stack_free(void *stack) {
+    stack_t disable = { .ss_sp = NULL, .ss_size = 0, .ss_flags = SS_DISABLE };
+    sigaltstack(&disable, NULL);
+    free(stack);
+}
+
+/*
+    Function: Create the key that frees per thread signal stacks
+*/
+static void log_flight_stack_key(void) {
+    pthread_key_create(&logCrashStackKey, log_flight_stack_free);
+}
+
+/*
+    Function: Give the calling thread its own signal stack so the crash handler can still dump
+              when this thread overflows its stack. Signal stacks are per thread, log_flight_start
+              only sets one up for the thread that calls it, so call this at the start of every
+              other thread worth covering. Nothing is done if the thread already has one. The
+              stack is freed when the thread exits
+*/
+int32_t log_flight_thread_init(void) {
+    stack_t current;
+    if (sigaltstack(NULL, &current) == 0 && !(current.ss_flags & SS_DISABLE)) {                     //  Already has a signal stack
+        return 1;
+    }
+    pthread_once(&logCrashStackOnce, log_flight_stack_key);
+    stack_t alt_stack = { .ss_sp = malloc(LOG_FLIGHT_ALT_STACK_SIZE), .ss_size = LOG_FLIGHT_ALT_STACK_SIZE, .ss_flags = 0 };
+    if (alt_stack.ss_sp == NULL || sigaltstack(&alt_stack, NULL) != 0) {
+        snprintf(errorArray, sizeof(errorArray), "%s: Signal Stack\n", __FUNCTION__);               //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        free(alt_stack.ss_sp);
+        return -1;                                                                                  //  Return error
+    }
+    pthread_setspecific(logCrashStackKey, alt_stack.ss_sp);
+    return 1;                                                                                       //  Return good
+}
+
+/*
+    Function: Keep the last lines at every level up to capture_level in memory, even levels the
+              file filters out, and dump them to the log on SIGSEGV, SIGABRT, SIGBUS, SIGFPE and
+              SIGILL. Lets a log run at LOG_WARN and still show the debug lines before a crash.
+              log_flight_dump writes it out on demand. One log per process gets the crash handler,
+              the handlers it replaces still run after the dump. Only the calling thread gets a
+              signal stack, see log_flight_thread_init for the others
+    log_info: Struct that hold file descriptor and log file information
+    records: Lines kept (0 uses LOG_FLIGHT_DEFAULT_RECORDS)
+    capture_level: Highest level kept
+*/
+int32_t log_flight_start(log_info_t *log_info, uint32_t records, uint8_t capture_level) {
+    if (log_info->flight != NULL) {                                                                 //  Already recording, only move the level
+        log_info->capture_level = capture_level;
+        return 1;
+    }
+    log_flight_t *flight = calloc(1, sizeof(log_flight_t));
+    records = records ? records : LOG_FLIGHT_DEFAULT_RECORDS;
+    if (flight == NULL || (flight->slots = calloc(records, sizeof(log_flight_slot_t))) == NULL) {   //  calloc so every slot starts incomplete
+        snprintf(errorArray, sizeof(errorArray), "%s: Allocate Flight Recorder\n", __FUNCTION__);   //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        free(flight);
+        return -1;                                                                                  //  Return error
+    }
+    flight->records = records;
+    atomic_init(&flight->head, 0);
+    log_info->flight = flight;
+    log_info->capture_level = capture_level;
+
+    if (logCrashLog == NULL) {                                                                      //  First flight recorder owns the crash handler
+        log_flight_thread_init();                                                                   //  For the calling thread's stack overflows
+        struct sigaction action = {0};
+        action.sa_sigaction = log_crash_handler;
+        action.sa_flags = SA_ONSTACK | SA_SIGINFO;
+        sigemptyset(&action.sa_mask);
+        logCrashLog = log_info;
+        for (uint32_t i = 0; i < sizeof(logCrashSignals) / sizeof(logCrashSignals[0]); i++) {
+            sigaction(logCrashSignals[i], &action, &logCrashOld[logCrashSignals[i]]);
+        }
+    }
+    return 1;                                                                                       //  Return good
 }
 
 /*
@@ -120,20 +1913,10 @@ void *monitorFileSize(void *args) {
     ...: arguements to the string
 */
 void log_fatal(log_info_t *log_info, const uint8_t *fmt, ...) {
-    if (log_info->log_level >= LOG_FATAL) {
+    if (LOG_LEVEL_ENABLED(log_info, LOG_FATAL)) {
         va_list ap;
         va_start(ap, fmt);
-        uint8_t ts[20];
-    get_timestamp(ts, sizeof(ts));
-    uint8_t *msg = fmt_to_buffer(fmt, ap);
-    if (!msg) {
-        return;
-    }
-    dprintf(log_info->fd, "[%s] LOG_FATAL: %s\n", ts, msg);
-    free(msg);
-    pthread_mutex_lock(&log_info->monitorLock);
-    pthread_cond_signal(&log_info->monitorCond);
-    pthread_mutex_unlock(&log_info->monitorLock);
+        log_write(log_info, LOG_FATAL, fmt, ap);
         va_end(ap);
     }
 }
@@ -145,20 +1928,10 @@ void log_fatal(log_info_t *log_info, const uint8_t *fmt, ...) {
     ...: arguements to the string
 */
 void log_error(log_info_t *log_info, const uint8_t *fmt, ...) {
-    if (log_info->log_level >= LOG_ERROR) {
+    if (LOG_LEVEL_ENABLED(log_info, LOG_ERROR)) {
         va_list ap;
         va_start(ap, fmt);
-        uint8_t ts[20];
-    get_timestamp(ts, sizeof(ts));
-    uint8_t *msg = fmt_to_buffer(fmt, ap);
-    if (!msg) {
-        return;
-    }
-    dprintf(log_info->fd, "[%s] LOG_ERROR: %s\n", ts, msg);
-    free(msg);
-    pthread_mutex_lock(&log_info->monitorLock);
-    pthread_cond_signal(&log_info->monitorCond);
-    pthread_mutex_unlock(&log_info->monitorLock);
+        log_write(log_info, LOG_ERROR, fmt, ap);
         va_end(ap);
     }
 }
@@ -170,20 +1943,10 @@ void log_error(log_info_t *log_info, const uint8_t *fmt, ...) {
     ...: arguements to the string
 */
 void log_warn(log_info_t *log_info, const uint8_t *fmt, ...) {
-    if (log_info->log_level >= LOG_WARN) {
+    if (LOG_LEVEL_ENABLED(log_info, LOG_WARN)) {
         va_list ap;
         va_start(ap, fmt);
-        uint8_t ts[20];
-        get_timestamp(ts, sizeof(ts));
-        uint8_t *msg = fmt_to_buffer(fmt, ap);
-        if (!msg) {
-            return;
-        }
-        dprintf(log_info->fd, "[%s] LOG_WARN: %s\n", ts, msg);
-        free(msg);
-        pthread_mutex_lock(&log_info->monitorLock);
-        pthread_cond_signal(&log_info->monitorCond);
-        pthread_mutex_unlock(&log_info->monitorLock);
+        log_write(log_info, LOG_WARN, fmt, ap);
         va_end(ap);
     }
 }
@@ -195,20 +1958,10 @@ void log_warn(log_info_t *log_info, const uint8_t *fmt, ...) {
     ...: arguements to the string
 */
 void log_info(log_info_t *log_info, const uint8_t *fmt, ...) {
-    if (log_info->log_level >= LOG_INFO) {
+    if (LOG_LEVEL_ENABLED(log_info, LOG_INFO)) {
         va_list ap;
         va_start(ap, fmt);
-        uint8_t ts[20];
-        get_timestamp(ts, sizeof(ts));
-        uint8_t *msg = fmt_to_buffer(fmt, ap);
-        if (!msg) {
-            return;
-        }
-        dprintf(log_info->fd, "[%s] LOG_INFO: %s\n", ts, msg);
-        free(msg);
-        pthread_mutex_lock(&log_info->monitorLock);
-        pthread_cond_signal(&log_info->monitorCond);
-        pthread_mutex_unlock(&log_info->monitorLock);
+        log_write(log_info, LOG_INFO, fmt, ap);
         va_end(ap);
     }
 }
@@ -220,20 +1973,10 @@ void log_info(log_info_t *log_info, const uint8_t *fmt, ...) {
     ...: arguements to the string
 */
 void log_debug(log_info_t *log_info, const uint8_t *fmt, ...) {
-    if (log_info->log_level >= LOG_DEBUG) {
+    if (LOG_LEVEL_ENABLED(log_info, LOG_DEBUG)) {
         va_list ap;
         va_start(ap, fmt);
-        uint8_t ts[20];
-        get_timestamp(ts, sizeof(ts));
-        uint8_t *msg = fmt_to_buffer(fmt, ap);
-        if (!msg) {
-            return;
-        }
-        dprintf(log_info->fd, "[%s] LOG_DEBUG: %s\n", ts, msg);
-        free(msg);
-        pthread_mutex_lock(&log_info->monitorLock);
-        pthread_cond_signal(&log_info->monitorCond);
-        pthread_mutex_unlock(&log_info->monitorLock);
+        log_write(log_info, LOG_DEBUG, fmt, ap);
         va_end(ap);
     }
 }
@@ -245,20 +1988,10 @@ void log_debug(log_info_t *log_info, const uint8_t *fmt, ...) {
     ...: arguements to the string
 */
 void log_debug_ex0(log_info_t *log_info, const uint8_t *fmt, ...) {
-    if (log_info->log_level >= LOG_DEBUG_EX0) {
+    if (LOG_LEVEL_ENABLED(log_info, LOG_DEBUG_EX0)) {
         va_list ap;
         va_start(ap, fmt);
-        uint8_t ts[20];
-        get_timestamp(ts, sizeof(ts));
-        uint8_t *msg = fmt_to_buffer(fmt, ap);
-        if (!msg) {
-            return;
-        }
-        dprintf(log_info->fd, "[%s] LOG_DEBUG_EX0: %s\n", ts, msg);
-        free(msg);
-        pthread_mutex_lock(&log_info->monitorLock);
-        pthread_cond_signal(&log_info->monitorCond);
-        pthread_mutex_unlock(&log_info->monitorLock);
+        log_write(log_info, LOG_DEBUG_EX0, fmt, ap);
         va_end(ap);
     }
 }
@@ -270,34 +2003,179 @@ void log_debug_ex0(log_info_t *log_info, const uint8_t *fmt, ...) {
     ...: arguements to the string
 */
 void log_debug_ex1(log_info_t *log_info, const uint8_t *fmt, ...) {
-    if (log_info->log_level >= LOG_DEBUG_EX1) {
+    if (LOG_LEVEL_ENABLED(log_info, LOG_DEBUG_EX1)) {
         va_list ap;
         va_start(ap, fmt);
-        uint8_t ts[20];
-        get_timestamp(ts, sizeof(ts));
-        uint8_t *msg = fmt_to_buffer(fmt, ap);
-        if (!msg) {
-            return;
-        }
-        dprintf(log_info->fd, "[%s] LOG_DEBUG_EX1: %s\n", ts, msg);
-        free(msg);
-        pthread_mutex_lock(&log_info->monitorLock);
-        pthread_cond_signal(&log_info->monitorCond);
-        pthread_mutex_unlock(&log_info->monitorLock);
+        log_write(log_info, LOG_DEBUG_EX1, fmt, ap);
         va_end(ap);
     }
 }
 
+/*
+    Function: Decide if a rate limited call site may log now. Uses one second windows on the coarse
+              monotonic clock and only atomics, the window reset can let a line or two extra through
+              when threads race on it
+    log_info: Log the call site writes to, used by log_close to report pending suppressions
+    site: Call site state
+    level: Level of the call site
+    per_sec: Lines allowed per second
+    suppressed: Set to the lines dropped in earlier windows when this call starts a new one, to be
+                reported by the caller even if this line is suppressed too. 0 otherwise
+    Return: 1 if the line should be written, 0 if it is suppressed
+*/
+uint8_t log_rate_allow(log_info_t *log_info, log_limit_t *site, uint8_t level, uint32_t per_sec, uint32_t *suppressed) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    uint64_t window = now.tv_sec;
+    uint64_t seen = atomic_load_explicit(&site->window, memory_order_relaxed);
+    *suppressed = 0;
+    if (seen != window && atomic_compare_exchange_strong(&site->window, &seen, window)) {           //  First call in a new second reports and resets
+        *suppressed = atomic_exchange_explicit(&site->suppressed, 0, memory_order_relaxed);
+        atomic_store_explicit(&site->count, 0, memory_order_relaxed);
+    }
+    if (atomic_fetch_add_explicit(&site->count, 1, memory_order_relaxed) < per_sec) {
+        return 1;
+    }
+    if (atomic_load_explicit(&site->log, memory_order_acquire) != log_info) {                       //  Bind to this log, the last one may be closed
+        site->level = level;
+        atomic_store_explicit(&site->log, log_info, memory_order_release);
+    }
+    if (!atomic_exchange(&site->registered, 1)) {                                                   //  First suppression, list the site for log_close
+        site->next = atomic_load(&logLimitSites);
+        while (!atomic_compare_exchange_weak(&logLimitSites, &site->next, site));
+    }
+    atomic_fetch_add_explicit(&site->suppressed, 1, memory_order_relaxed);
+    return 0;
+}
+
+/*
+    Function: log at a level only known at run time
+    log_info: Struct that hold file descriptor and log file information
+    level: Level of the line
+    fmt: orignal string
+    ...: arguements to the string
+*/
+static void log_write_level(log_info_t *log_info, uint8_t level, const uint8_t *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    log_write(log_info, level, fmt, ap);
+    va_end(ap);
+}
+
+/*
+    Function: Write the suppressed counts still pending at the rate limited call sites of a log,
+              so lines dropped in the last window are not lost silently. The sites are unbound
+              from the log afterwards so none keeps a pointer to it once it is closed
+    log_info: Struct that hold file descriptor and log file information
+*/
+static void log_rate_flush(log_info_t *log_info) {
+    for (log_limit_t *site = atomic_load(&logLimitSites); site != NULL; site = site->next) {
+        if (atomic_load_explicit(&site->log, memory_order_acquire) != log_info) {
+            continue;
+        }
+        uint32_t suppressed = atomic_exchange_explicit(&site->suppressed, 0, memory_order_relaxed);
+        if (suppressed > 0 && LOG_LEVEL_ENABLED(log_info, site->level)) {
+            log_write_level(log_info, site->level, "suppressed %u messages at %s:%d", suppressed, site->file, site->line);
+        }
+        log_info_t *bound = log_info;
+        atomic_compare_exchange_strong(&site->log, &bound, NULL);                                   //  Unbind, the log is going away
+    }
+}
+
+/*
+    Function: Decide if a sampled call site may log now
+    site: Call site state
+    every: Write one line out of every this many (0 or 1 writes all)
+    Return: 1 if the line should be written, 0 if it is skipped
+*/
+uint8_t log_sample_allow(log_limit_t *site, uint32_t every) {
+    if (every <= 1) {
+        return 1;
+    }
+    return (atomic_fetch_add_explicit(&site->count, 1, memory_order_relaxed) % every) == 0;
+}
+
 /*
     Function: Close file descriptor and close thread
     log_info: Struct that hold file descriptor and log file information
 */
 void log_close(log_info_t *log_info) {
-    if (log_info->monitorThread_Flag) {
+    log_rate_flush(log_info);                                                                       //  Report suppressions while every writer still runs
+    if (log_info->async != NULL) {                                                                  //  Drain and stop the async writer
+        log_async_t *async = log_info->async;
+        atomic_store_explicit(&async->running, 0, memory_order_release);
+        pthread_join(async->writerThread, NULL);
+        log_info->async = NULL;
+        mpmcQueueDestroy(async->ring);
+        free(async);
+    }
+    if (log_info->merge != NULL) {                                                                  //  Drain and stop the merger
+        log_merge_t *merge = log_info->merge;
+        atomic_store_explicit(&merge->running, 0, memory_order_release);
+        pthread_join(merge->mergerThread, NULL);
+        log_info->merge = NULL;
+        log_thread_buf_t *buf = atomic_load(&merge->head);
+        while (buf != NULL) {
+            log_thread_buf_t *next = buf->next;
+            mpmcQueueDestroy(buf->ring);
+            free(buf);
+            buf = next;
+        }
+        pthread_mutex_destroy(&merge->lock);
+        free(merge);
+    }
+    while (log_info->sinks != NULL) {                                                               //  Drain and stop every sink
+        log_sink_t *sink = log_info->sinks;
+        atomic_store_explicit(&sink->running, 0, memory_order_release);
+        pthread_join(sink->writerThread, NULL);
+        log_info->sinks = sink->next;
+        log_sink_free(sink);
+    }
+    log_info->sink_level = 0;
+    if (log_info->monitorThread_Flag) {                                                             //  Stop the monitor thread
+        pthread_mutex_lock(&log_info->monitorLock);
         log_info->monitorThread_Flag = 0;
-        pthread_cancel(log_info->monitorThread);
+        pthread_cond_signal(&log_info->monitorCond);
+        pthread_mutex_unlock(&log_info->monitorLock);
         pthread_join(log_info->monitorThread, NULL);
     }
+    if (log_info->compress != NULL) {                                                               //  Stop the compressor between files
+        log_compress_t *compress = log_info->compress;
+        pthread_mutex_lock(&compress->lock);
+        compress->running = 0;
+        pthread_cond_signal(&compress->cond);
+        pthread_mutex_unlock(&compress->lock);
+        pthread_join(compress->compressThread, NULL);
+        log_info->compress = NULL;
+        pthread_cond_destroy(&compress->cond);
+        pthread_mutex_destroy(&compress->lock);
+        free(compress);
+    }
+    if (logCrashLog == log_info) {                                                                  //  Put back the crash handlers we replaced
+        for (uint32_t i = 0; i < sizeof(logCrashSignals) / sizeof(logCrashSignals[0]); i++) {
+            sigaction(logCrashSignals[i], &logCrashOld[logCrashSignals[i]], NULL);
+        }
+        logCrashLog = NULL;
+    }
+    if (log_info->flight != NULL) {
+        free(log_info->flight->slots);
+        free(log_info->flight);
+        log_info->flight = NULL;
+        log_info->capture_level = 0;
+    }
+    if (log_info->mmap != NULL) {                                                                   //  Trim the file to the used bytes
+        log_mmap_t *m = log_info->mmap;
+        uint64_t used = atomic_load(&m->offset);
+        if (m->map != NULL) {
+            munmap(m->map, m->map_len);
+        }
+        ftruncate(log_info->fd, m->file_off + (used == LOG_MMAP_CLOSED ? 0 : used));
+        pthread_mutex_destroy(&m->lock);
+        free(m);
+        log_info->mmap = NULL;
+    }
+    free(log_info->bin);                                                                            //  Binary state, NULL in text mode
+    log_info->bin = NULL;
     close(log_info->fd);
 }
 
@@ -307,10 +2185,20 @@ void log_close(log_info_t *log_info) {
     sz: size of buffer string
 */
 void get_timestamp(uint8_t *buf, size_t sz) {
-    time_t now = time(NULL);
-    struct tm tm;
-    localtime_r(&now, &tm);
-    strftime(buf, sz, "%Y-%m-%d %H:%M:%S", &tm);
+    log_timestamp(buf, sz, LOG_TS_SECONDS);
+}
+
+/*
+    Function: Write the current CLOCK_REALTIME time as "YYYY-mm-dd HH:MM:SS[.fraction]"
+    buf: Buffer to write to
+    sz: Size of buffer, LOG_TIMESTAMP_SIZE always fits
+    digits: Fraction digits, 0 - 9
+    Return: Length written, not counting the terminator
+*/
+size_t log_timestamp(uint8_t *buf, size_t sz, uint8_t digits) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return log_timestamp_at(buf, sz, digits, &now);
 }
 
 /*
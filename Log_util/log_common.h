@@ -14,6 +14,13 @@
 #include <errno.h>
 #include <time.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sched.h>
+#pragma pack(push, 8)               //  stack_t and struct sigaction are read by the kernel and libc, keep their layout
+#include <signal.h>
+#pragma pack(pop)
 
 /*
 ---------------------------------------------------------------------------------
@@ -29,31 +36,242 @@ Defined Variables
 #define LOG_DEBUG_EX1                       (7)
 
 #define LOG_PATH_SIZE                       (120)
+#define LOG_TS_SECONDS                      (0)             //  Timestamp fraction digits
+#define LOG_TS_MILLI                        (3)
+#define LOG_TS_MICRO                        (6)
+#define LOG_TS_NANO                         (9)
+#define LOG_TS_DEFAULT                      (LOG_TS_MICRO)
+#define LOG_TIMESTAMP_SIZE                  (32)            //  "YYYY-mm-dd HH:MM:SS.nnnnnnnnn" and terminator
+
+#define LOG_SCRATCH_SIZE                    (1024)          //  Lines up to this size are formatted without allocating
+#define LOG_DEFAULT_MAX_FILES               (5)             //  Rotated files kept as path.1 .. path.N
+
+#define LOG_ASYNC_RECORD_SIZE               (512)           //  Max formatted line length in async mode, longer lines are truncated
+#define LOG_ASYNC_DEFAULT_RECORDS           (4096)          //  Default async ring size in records
+#define LOG_ASYNC_BATCH                     (64)            //  Max records handed to one writev
+#define LOG_ASYNC_IDLE_US                   (1000)          //  Writer sleep when the ring is empty
+
+#define LOG_MERGE_DEFAULT_RECORDS           (1024)          //  Default per thread ring size in records
+#define LOG_MERGE_GRACE_US                  (2000)          //  How long the merger waits on idle threads before writing newer lines
+
+#define LOG_SINK_FILE                       (1)             //  Extra log file
+#define LOG_SINK_UDP                        (2)             //  Syslog style datagrams, "<PRI>line"
+#define LOG_SINK_MEMORY                     (3)             //  In memory ring that keeps the newest lines
+#define LOG_SINK_DEFAULT_RECORDS            (1024)          //  Default per sink queue size in records
+#define LOG_SYSLOG_FACILITY                 (1)             //  Syslog "user" facility used in <PRI>
+
+#define LOG_FLIGHT_DEFAULT_RECORDS          (1024)          //  Default flight recorder size in lines
+#define LOG_FLIGHT_RECORD_SIZE              (256)           //  Longer lines are truncated in the flight recorder
+#define LOG_FLIGHT_ALT_STACK_SIZE           (64 * 1024)     //  Signal stack so a stack overflow can still dump
+
+#define LOG_MMAP_DEFAULT_SEGMENT            (64ULL << 20)   //  Bytes mapped at a time in mmap mode
+#define LOG_MMAP_MIN_SEGMENT                (1ULL << 20)
+#define LOG_MMAP_CLOSED                     (UINT64_MAX)    //  Offset value that stops reservations during a segment switch
+
+#define LOG_BIN_MAGIC                       "LOGBIN01"      //  First bytes of every binary log file
+#define LOG_BIN_MAGIC_SIZE                  (8)
+#define LOG_BIN_MAX_ARGS                    (16)            //  Max conversions in one binary format string
+#define LOG_BIN_MAX_FORMATS                 (4096)          //  Max registered format strings per process
+#define LOG_BIN_MAX_FORMAT_LEN              (1024)          //  Longer format strings are not registered
+#define LOG_BIN_TEXT_ID                     (1)             //  Built in "%s" format used for already formatted text
+#define LOG_BIN_UNSUPPORTED                 (0xFFFFFFFF)    //  Call site whose format can not be deferred
+
+#define LOG_BIN_REC_FORMAT                  ('F')           //  Format definition record
+#define LOG_BIN_REC_EVENT                   ('E')           //  Log event record
+
+#define LOG_BIN_ARG_INT                     (1)             //  int and anything promoted to it (hh, h, c)
+#define LOG_BIN_ARG_LONG                    (2)             //  long
+#define LOG_BIN_ARG_LLONG                   (3)             //  long long, intmax_t
+#define LOG_BIN_ARG_SIZE                    (4)             //  size_t, ptrdiff_t
+#define LOG_BIN_ARG_DOUBLE                  (5)             //  double and float
+#define LOG_BIN_ARG_LDOUBLE                 (6)             //  long double
+#define LOG_BIN_ARG_STR                     (7)             //  String, stored as uint16_t length and bytes
+#define LOG_BIN_ARG_PTR                     (8)             //  Pointer value
 
 /*
 ---------------------------------------------------------------------------------
 Structs
 ---------------------------------------------------------------------------------
 */ 
-//  Log Information Struct
+//  Async Logger State (defined in log_common.c)
+struct _log_async_t;
+
+//  Binary Logger State (defined in log_common.c)
+struct _log_bin_t;
+
+//  Memory Mapped Sink State (defined in log_common.c)
+struct _log_mmap_t;
+
+//  Per Thread Buffer Merger State (defined in log_common.c)
+struct _log_merge_t;
+
+//  Fan Out Sink (defined in log_common.c)
+struct _log_sink_t;
+
+//  Rotated Segment Compressor State (defined in log_common.c)
+struct _log_compress_t;
+
+//  Flight Recorder (defined in log_common.c)
+struct _log_flight_t;
+
+//  Binary Log Format Definition Record, followed by the format string bytes
+typedef struct _log_bin_format_t {
+    uint8_t type;
+    uint16_t len;
+    uint32_t id;
+    uint8_t nargs;
+    uint8_t types[LOG_BIN_MAX_ARGS];
+} log_bin_format_t, *p_log_bin_format_t;
+
+//  Binary Log Event Record, followed by the raw argument bytes
+typedef struct _log_bin_event_t {
+    uint8_t type;
+    uint16_t len;
+    uint32_t id;
+    uint8_t level;
+    uint64_t ts_ns;
+} log_bin_event_t, *p_log_bin_event_t;
+
+//  Log Information Struct (natural alignment, the pthread members need it)
+#pragma pack(push, 8)
 typedef struct _log_info_t {
     int32_t fd;
     uint8_t file_path[LOG_PATH_SIZE];
-    uint16_t max_size;
+    uint64_t max_size;
     uint8_t log_level;
+    uint8_t capture_level;                                                                          //  Highest level kept by the flight recorder
+    uint8_t sink_level;                                                                             //  Highest level any sink takes
+    uint8_t max_files;
+    uint32_t rotate_secs;
+    time_t opened_at;
+    uint8_t stdout_redirect;
+    uint8_t ts_digits;
     pthread_t monitorThread;
     uint8_t monitorThread_Flag;
     pthread_cond_t monitorCond;
     pthread_mutex_t monitorLock;
+    pthread_mutex_t rotateLock;                                                                     //  Held while the file is swapped, writers never take it
+    struct _log_async_t *async;
+    struct _log_bin_t *bin;
+    struct _log_mmap_t *mmap;
+    struct _log_merge_t *merge;
+    struct _log_sink_t *sinks;
+    struct _log_compress_t *compress;
+    struct _log_flight_t *flight;
 } log_info_t, *p_log_info_t;
 
+//  Per Call Site Rate Limit / Sample State, one static instance per call site
+//  A rate limited site joins a process wide list the first time it suppresses a line, so
+//  log_close can report what is still pending. The site is bound to the log of its latest
+//  suppression and log_close unbinds it, so a site never points at a closed log
+typedef struct _log_limit_t {
+    _Atomic uint64_t window;
+    _Atomic uint32_t count;
+    _Atomic uint32_t suppressed;
+    _Atomic uint8_t registered;
+    uint8_t level;
+    int32_t line;
+    const uint8_t *file;
+    log_info_t *_Atomic log;
+    struct _log_limit_t *next;
+} log_limit_t, *p_log_limit_t;
+#pragma pack(pop)
+
+/*
+---------------------------------------------------------------------------------
+Macros
+---------------------------------------------------------------------------------
+*/
+//  Lowest priority level compiled in. Build with -DLOG_COMPILE_LEVEL=LOG_INFO (or 4) to remove
+//  every LOG_MSG_DEBUG* call and its arguments from the binary
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL                   LOG_DEBUG_EX1
+#endif
+
+//  True if a line at this level would be written, taken by a sink or kept by the flight recorder.
+//  The compile time half folds away for constant levels, the runtime half is three compares done
+//  in an inline function so p_log is evaluated once
+static inline uint8_t log_level_enabled(const log_info_t *log_info, uint8_t level) {
+    return (log_info->log_level >= level || log_info->sink_level >= level || log_info->capture_level >= level);
+}
+#define LOG_LEVEL_ENABLED(p_log, level)     ((level) <= LOG_COMPILE_LEVEL && log_level_enabled((p_log), (level)))
+
+//  Level front ends. Arguments are only evaluated when the level is enabled, p_log exactly once
+#define LOG_MSG(p_log, level, func, ...)                                                            \
+    do {                                                                                            \
+        log_info_t *log_call_info = (p_log);                                                        \
+        if (LOG_LEVEL_ENABLED(log_call_info, level)) {                                              \
+            func(log_call_info, __VA_ARGS__);                                                       \
+        }                                                                                           \
+    } while (0)
+#define LOG_MSG_FATAL(p_log, ...)           LOG_MSG(p_log, LOG_FATAL, log_fatal, __VA_ARGS__)
+#define LOG_MSG_ERROR(p_log, ...)           LOG_MSG(p_log, LOG_ERROR, log_error, __VA_ARGS__)
+#define LOG_MSG_WARN(p_log, ...)            LOG_MSG(p_log, LOG_WARN, log_warn, __VA_ARGS__)
+#define LOG_MSG_INFO(p_log, ...)            LOG_MSG(p_log, LOG_INFO, log_info, __VA_ARGS__)
+#define LOG_MSG_DEBUG(p_log, ...)           LOG_MSG(p_log, LOG_DEBUG, log_debug, __VA_ARGS__)
+#define LOG_MSG_DEBUG_EX0(p_log, ...)       LOG_MSG(p_log, LOG_DEBUG_EX0, log_debug_ex0, __VA_ARGS__)
+#define LOG_MSG_DEBUG_EX1(p_log, ...)       LOG_MSG(p_log, LOG_DEBUG_EX1, log_debug_ex1, __VA_ARGS__)
+
+//  Rate limited call, at most per_sec lines per second from this call site. Lines over the limit
+//  are counted and reported as one "suppressed" line by the first call of the next second, and
+//  by log_close for whatever is still pending
+#define LOG_MSG_LIMITED(p_log, level, func, per_sec, ...)                                           \
+    do {                                                                                            \
+        static log_limit_t log_limit_site = { .file = (const uint8_t *) __FILE__, .line = __LINE__ }; \
+        log_info_t *log_call_info = (p_log);                                                        \
+        uint32_t log_suppressed;                                                                    \
+        if (LOG_LEVEL_ENABLED(log_call_info, level)) {                                              \
+            uint8_t log_allowed = log_rate_allow(log_call_info, &log_limit_site, (level), (per_sec), &log_suppressed); \
+            if (log_suppressed) {                                                                   \
+                func(log_call_info, "suppressed %u messages at %s:%d", log_suppressed, __FILE__, __LINE__); \
+            }                                                                                       \
+            if (log_allowed) {                                                                      \
+                func(log_call_info, __VA_ARGS__);                                                   \
+            }                                                                                       \
+        }                                                                                           \
+    } while (0)
+
+//  Sampled call, only every Nth line from this call site is written
+#define LOG_MSG_SAMPLED(p_log, level, func, every, ...)                                             \
+    do {                                                                                            \
+        static log_limit_t log_limit_site;                                                          \
+        log_info_t *log_call_info = (p_log);                                                        \
+        if (LOG_LEVEL_ENABLED(log_call_info, level) && log_sample_allow(&log_limit_site, (every))) { \
+            func(log_call_info, __VA_ARGS__);                                                       \
+        }                                                                                           \
+    } while (0)
+#define LOG_MSG_ERROR_LIMITED(p_log, per_sec, ...)      LOG_MSG_LIMITED(p_log, LOG_ERROR, log_error, per_sec, __VA_ARGS__)
+#define LOG_MSG_WARN_LIMITED(p_log, per_sec, ...)       LOG_MSG_LIMITED(p_log, LOG_WARN, log_warn, per_sec, __VA_ARGS__)
+#define LOG_MSG_INFO_LIMITED(p_log, per_sec, ...)       LOG_MSG_LIMITED(p_log, LOG_INFO, log_info, per_sec, __VA_ARGS__)
+#define LOG_MSG_DEBUG_SAMPLED(p_log, every, ...)        LOG_MSG_SAMPLED(p_log, LOG_DEBUG, log_debug, every, __VA_ARGS__)
+#define LOG_MSG_DEBUG_EX0_SAMPLED(p_log, every, ...)    LOG_MSG_SAMPLED(p_log, LOG_DEBUG_EX0, log_debug_ex0, every, __VA_ARGS__)
+#define LOG_MSG_DEBUG_EX1_SAMPLED(p_log, every, ...)    LOG_MSG_SAMPLED(p_log, LOG_DEBUG_EX1, log_debug_ex1, every, __VA_ARGS__)
+
+//  Binary log call. The format string is registered once per call site and each call only
+//  stores the format id, a raw timestamp and the raw arguments. Falls back to text formatting
+//  when the log is not in binary mode or the format can not be deferred
+#define LOG_BIN(log_info, level, fmt, ...)                                                          \
+    do {                                                                                            \
+        static _Atomic uint32_t log_bin_site_id;                                                    \
+        log_info_t *log_call_info = (log_info);                                                     \
+        if (LOG_LEVEL_ENABLED(log_call_info, level)) {                                              \
+            uint32_t log_bin_id = atomic_load_explicit(&log_bin_site_id, memory_order_acquire);     \
+            if (log_bin_id == 0) {                                                                  \
+                log_bin_id = log_bin_register((const uint8_t *) (fmt), &log_bin_site_id);          \
+            }                                                                                       \
+            log_bin_write(log_call_info, (level), log_bin_id, (const uint8_t *) (fmt), ##__VA_ARGS__); \
+        }                                                                                           \
+    } while (0)
+
 /*
 ---------------------------------------------------------------------------------
 Functions
 ---------------------------------------------------------------------------------
 */
-int32_t log_print_init(log_info_t *log_info, const uint8_t *log_path, uint16_t max_size, uint8_t log_level);
-int32_t log_str_init(log_info_t *log_info, const uint8_t *log_path, uint16_t max_size, uint8_t log_level);
+int32_t log_print_init(log_info_t *log_info, const uint8_t *log_path, uint64_t max_size, uint8_t log_level);
+int32_t log_str_init(log_info_t *log_info, const uint8_t *log_path, uint64_t max_size, uint8_t log_level);
+void log_set_rotation(log_info_t *log_info, uint8_t max_files, uint32_t rotate_secs);
+void log_set_timestamp_precision(log_info_t *log_info, uint8_t digits);
 void *monitorFileSize(void *args);
 void log_fatal(log_info_t *log_info, const uint8_t *fmt, ...);
 void log_error(log_info_t *log_info, const uint8_t *fmt, ...);
@@ -62,8 +280,25 @@ void log_info(log_info_t *log_info, const uint8_t *fmt, ...);
 void log_debug(log_info_t *log_info, const uint8_t *fmt, ...);
 void log_debug_ex0(log_info_t *log_info, const uint8_t *fmt, ...);
 void log_debug_ex1(log_info_t *log_info, const uint8_t *fmt, ...);
+int32_t log_async_start(log_info_t *log_info, uint32_t records);
+int32_t log_bin_start(log_info_t *log_info);
+int32_t log_mmap_start(log_info_t *log_info, uint64_t segment_size);
+int32_t log_merge_start(log_info_t *log_info, uint32_t records);
+int32_t log_sink_add_file(log_info_t *log_info, const uint8_t *path, uint8_t level);
+int32_t log_sink_add_udp(log_info_t *log_info, const uint8_t *ip, uint16_t port, uint8_t level);
+int32_t log_sink_add_memory(log_info_t *log_info, uint32_t bytes, uint8_t level);
+int64_t log_sink_memory_dump(log_info_t *log_info, int32_t fd);
+int32_t log_compress_start(log_info_t *log_info);
+int32_t log_flight_start(log_info_t *log_info, uint32_t records, uint8_t capture_level);
+int32_t log_flight_thread_init(void);
+void log_flight_dump(log_info_t *log_info, int32_t fd);
+uint32_t log_bin_register(const uint8_t *fmt, _Atomic uint32_t *site_id);
+void log_bin_write(log_info_t *log_info, uint8_t level, uint32_t id, const uint8_t *fmt, ...);
+uint8_t log_rate_allow(log_info_t *log_info, log_limit_t *site, uint8_t level, uint32_t per_sec, uint32_t *suppressed);
+uint8_t log_sample_allow(log_limit_t *site, uint32_t every);
 void log_close(log_info_t *log_info);
 void get_timestamp(uint8_t *buf, size_t sz);
+size_t log_timestamp(uint8_t *buf, size_t sz, uint8_t digits);
 uint8_t *fmt_to_buffer(const uint8_t *fmt, va_list ap);
 
 #endif
@@ -0,0 +1,272 @@
+//  Developed Libraries
+#include "log_compress.h"
+
+
+static uint8_t errorArray[120] = {0};
+
+/*
+    Function: Read 4 bytes from any alignment
+    p: Source
+*/
+static inline uint32_t log_lz_read32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/*
+    Function: Write a 4 bit field overflow as 255 runs plus a final byte
+    op: Output position, advanced
+    n: Length beyond 15
+*/
+static inline uint8_t *log_lz_put_length(uint8_t *op, uint32_t n) {
+    while (n >= 255) {
+        *op++ = 255;
+        n -= 255;
+    }
+    *op++ = n;
+    return op;
+}
+
+/*
+    Function: Emit one sequence, literals then an optional match
+    op: Output position
+    oend: End of output
+    lit: Literal bytes
+    lit_len: Number of literals
+    offset: Match distance back, 0 for the final literals only sequence
+    match_len: Match length, at least LOG_LZ_MIN_MATCH when offset is set
+    Return: New output position, NULL if it would not fit
+*/
+static uint8_t *log_lz_emit(uint8_t *op, const uint8_t *oend, const uint8_t *lit, uint32_t lit_len, uint32_t offset, uint32_t match_len) {
+    uint32_t ml = offset ? match_len - LOG_LZ_MIN_MATCH : 0;
+    if ((size_t) (oend - op) < 1 + lit_len / 255 + 1 + lit_len + 2 + ml / 255 + 1) {
+        return NULL;
+    }
+    uint8_t *token = op++;
+    *token = ((lit_len < 15 ? lit_len : 15) << 4) | (ml < 15 ? ml : 15);
+    if (lit_len >= 15) {
+        op = log_lz_put_length(op, lit_len - 15);
+    }
+    memcpy(op, lit, lit_len);
+    op += lit_len;
+    if (offset) {
+        *op++ = offset & 0xFF;
+        *op++ = offset >> 8;
+        if (ml >= 15) {
+            op = log_lz_put_length(op, ml - 15);
+        }
+    }
+    return op;
+}
+
+/*
+    Function: Compress one block with a greedy single probe hash match finder
+    src: Raw bytes, at most LOG_LZ_BLOCK_SIZE
+    len: Number of raw bytes
+    dst: Output buffer
+    cap: Size of the output buffer
+    Return: Compressed size, 0 if it did not fit in cap (store the block raw)
+*/
+uint32_t log_lz_compress(const uint8_t *src, uint32_t len, uint8_t *dst, uint32_t cap) {
+    uint16_t table[1 << LOG_LZ_HASH_BITS] = {0};                                                    //  Last position seen for each hash
+    const uint8_t *oend = dst + cap;
+    uint8_t *op = dst;
+    uint32_t anchor = 0;
+    uint32_t ip = 1;
+    uint32_t limit = (len > 12) ? len - 12 : 0;                                                     //  Leave trailing literals so the decoder never overreads
+    while (ip < limit) {
+        uint32_t seq = log_lz_read32(src + ip);
+        uint32_t hash = (seq * 2654435761U) >> (32 - LOG_LZ_HASH_BITS);
+        uint32_t cand = table[hash];
+        table[hash] = ip;
+        if (cand >= ip || ip - cand > 0xFFFF || log_lz_read32(src + cand) != seq) {
+            ip++;
+            continue;
+        }
+        uint32_t match_len = LOG_LZ_MIN_MATCH;
+        while (ip + match_len < len - 5 && src[cand + match_len] == src[ip + match_len]) {
+            match_len++;
+        }
+        if ((op = log_lz_emit(op, oend, src + anchor, ip - anchor, ip - cand, match_len)) == NULL) {
+            return 0;
+        }
+        ip += match_len;
+        anchor = ip;
+    }
+    if ((op = log_lz_emit(op, oend, src + anchor, len - anchor, 0, 0)) == NULL) {
+        return 0;
+    }
+    return op - dst;
+}
+
+/*
+    Function: Decompress one block, every read and write is bounds checked
+    src: Compressed bytes
+    len: Number of compressed bytes
+    dst: Output buffer
+    cap: Size of the output buffer
+    Return: Raw size, -1 if the block is corrupt
+*/
+int32_t log_lz_decompress(const uint8_t *src, uint32_t len, uint8_t *dst, uint32_t cap) {
+    const uint8_t *ip = src;
+    const uint8_t *iend = src + len;
+    uint8_t *op = dst;
+    uint8_t *oend = dst + cap;
+    while (ip < iend) {
+        uint8_t token = *ip++;
+        size_t lit_len = token >> 4;
+        if (lit_len == 15) {
+            uint8_t b;
+            do {
+                if (ip >= iend) {
+                    return -1;
+                }
+                b = *ip++;
+                lit_len += b;
+            } while (b == 255);
+        }
+        if ((size_t) (iend - ip) < lit_len || (size_t) (oend - op) < lit_len) {
+            return -1;
+        }
+        memcpy(op, ip, lit_len);
+        ip += lit_len;
+        op += lit_len;
+        if (ip == iend) {                                                                           //  Final literals only sequence
+            break;
+        }
+        if (iend - ip < 2) {
+            return -1;
+        }
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        size_t match_len = token & 0x0F;
+        if (match_len == 15) {
+            uint8_t b;
+            do {
+                if (ip >= iend) {
+                    return -1;
+                }
+                b = *ip++;
+                match_len += b;
+            } while (b == 255);
+        }
+        match_len += LOG_LZ_MIN_MATCH;
+        if (offset == 0 || offset > (size_t) (op - dst) || (size_t) (oend - op) < match_len) {
+            return -1;
+        }
+        const uint8_t *match = op - offset;
+        for (size_t i = 0; i < match_len; i++) {                                                    //  Byte copy, matches may overlap
+            op[i] = match[i];
+        }
+        op += match_len;
+    }
+    return op - dst;
+}
+
+/*
+    Function: Compress a whole file descriptor into another in LOG_LZ format
+    in_fd: File descriptor to read from the current position
+    out_fd: File descriptor to write to
+    Return: 1 on success, -1 on error
+*/
+int32_t log_lz_compress_fd(int32_t in_fd, int32_t out_fd) {
+    uint8_t *raw = malloc(LOG_LZ_BLOCK_SIZE);
+    uint8_t *packed = malloc(LOG_LZ_BOUND(LOG_LZ_BLOCK_SIZE));
+    int32_t status = -1;
+    if (raw == NULL || packed == NULL) {
+        snprintf(errorArray, sizeof(errorArray), "%s: Allocate Buffers\n", __FUNCTION__);           //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        goto done;
+    }
+    if (write(out_fd, LOG_LZ_MAGIC, LOG_LZ_MAGIC_SIZE) != LOG_LZ_MAGIC_SIZE) {
+        goto write_failed;
+    }
+    for (;;) {
+        uint32_t raw_len = 0;
+        ssize_t got = 0;
+        while (raw_len < LOG_LZ_BLOCK_SIZE && (got = read(in_fd, raw + raw_len, LOG_LZ_BLOCK_SIZE - raw_len)) > 0) {
+            raw_len += got;
+        }
+        if (got < 0) {
+            snprintf(errorArray, sizeof(errorArray), "%s: read\n", __FUNCTION__);                   //  Populate Error Array
+            perror(errorArray);                                                                     //  Print out this if it failed
+            goto done;
+        }
+        if (raw_len == 0) {
+            break;
+        }
+        uint32_t stored_len = log_lz_compress(raw, raw_len, packed, raw_len - 1);                   //  Must beat raw to be worth it
+        const uint8_t *stored = packed;
+        if (stored_len == 0) {
+            stored_len = raw_len;
+            stored = raw;
+        }
+        uint32_t header[2] = { raw_len, stored_len };
+        if (write(out_fd, header, sizeof(header)) != sizeof(header) || write(out_fd, stored, stored_len) != stored_len) {
+            goto write_failed;
+        }
+        if (raw_len < LOG_LZ_BLOCK_SIZE) {
+            break;
+        }
+    }
+    status = 1;
+    goto done;
+write_failed:
+    snprintf(errorArray, sizeof(errorArray), "%s: write\n", __FUNCTION__);                          //  Populate Error Array
+    perror(errorArray);                                                                             //  Print out this if it failed
+done:
+    free(raw);
+    free(packed);
+    return status;
+}
+
+/*
+    Function: Decompress a whole LOG_LZ file image held in memory
+    src: File bytes, starting with LOG_LZ_MAGIC
+    len: Number of file bytes
+    out: Set to a malloc'd buffer with the raw bytes, caller frees
+    out_len: Set to the raw size
+    Return: 1 on success, -1 if the data is not LOG_LZ or is corrupt
+*/
+int32_t log_lz_decompress_buffer(const uint8_t *src, size_t len, uint8_t **out, size_t *out_len) {
+    if (len < LOG_LZ_MAGIC_SIZE || memcmp(src, LOG_LZ_MAGIC, LOG_LZ_MAGIC_SIZE) != 0) {
+        return -1;
+    }
+    size_t pos = LOG_LZ_MAGIC_SIZE;
+    size_t used = 0;
+    size_t cap = 0;
+    uint8_t *buf = NULL;
+    while (pos < len) {
+        uint32_t header[2];
+        if (len - pos < sizeof(header)) {
+            goto corrupt;
+        }
+        memcpy(header, src + pos, sizeof(header));
+        pos += sizeof(header);
+        if (header[0] > LOG_LZ_BLOCK_SIZE || header[1] > len - pos) {
+            goto corrupt;
+        }
+        if (used + header[0] > cap) {
+            cap = (cap + header[0]) * 2;
+            uint8_t *grown = realloc(buf, cap);
+            if (grown == NULL) {
+                goto corrupt;
+            }
+            buf = grown;
+        }
+        if (header[1] == header[0]) {                                                               //  Stored block
+            memcpy(buf + used, src + pos, header[0]);
+        } else if (log_lz_decompress(src + pos, header[1], buf + used, header[0]) != (int32_t) header[0]) {
+            goto corrupt;
+        }
+        used += header[0];
+        pos += header[1];
+    }
+    *out = buf;
+    *out_len = used;
+    return 1;
+corrupt:
+    free(buf);
+    return -1;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#ifndef LOG_COMPRESS_H
+#define LOG_COMPRESS_H
+
+//  Standard Libraries
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+---------------------------------------------------------------------------------
+Defined Variables
+---------------------------------------------------------------------------------
+*/
+#define LOG_LZ_MAGIC                        "LOGLZ001"      //  First bytes of every compressed log
+#define LOG_LZ_MAGIC_SIZE                   (8)
+#define LOG_LZ_EXTENSION                    ".lz"
+#define LOG_LZ_BLOCK_SIZE                   (64 * 1024)     //  Raw bytes per block, keeps every match offset in 16 bits
+#define LOG_LZ_HASH_BITS                    (12)            //  4096 entry match table, 8 KiB of stack
+#define LOG_LZ_MIN_MATCH                    (4)
+#define LOG_LZ_BOUND(len)                   ((len) + (len) / 255 + 16)
+
+/*
+    File format: LOG_LZ_MAGIC, then blocks of
+        uint32_t raw_len, uint32_t stored_len, stored_len bytes
+    stored_len == raw_len means the block is stored uncompressed. A compressed block is a run of
+    LZ77 sequences: a token (literal count << 4 | match length - 4, 15 means more length bytes
+    follow, each 255 means keep reading), the literals, a 16 bit little endian match offset and
+    the extra match length bytes. The last sequence is literals only.
+*/
+
+/*
+---------------------------------------------------------------------------------
+Functions
+---------------------------------------------------------------------------------
+*/
+uint32_t log_lz_compress(const uint8_t *src, uint32_t len, uint8_t *dst, uint32_t cap);
+int32_t log_lz_decompress(const uint8_t *src, uint32_t len, uint8_t *dst, uint32_t cap);
+int32_t log_lz_compress_fd(int32_t in_fd, int32_t out_fd);
+int32_t log_lz_decompress_buffer(const uint8_t *src, size_t len, uint8_t **out, size_t *out_len);
+
+#endif
@@ -0,0 +1,280 @@
+/*
+    Binary log decoder. Turns files written after log_bin_start back into the
+    "[ts] LOG_LEVEL: msg" text that the text logger writes. Rotated files compressed by
+    log_compress_start (path.N.lz) are unpacked first, compressed text logs are printed as is.
+
+    Build: gcc -O2 -o log_decode log_decode.c log_compress.c
+    Usage: log_decode [-p digits] <binary log> [<binary log> ...] > log.txt
+
+    -p sets the sub second digits on each timestamp (0 - 9, default 6) like log_set_timestamp_precision.
+
+    Must run on a machine with the same type sizes and byte order as the writer.
+*/
+#define _GNU_SOURCE
+
+//  Developed Libraries
+#include "log_common.h"
+#include "log_compress.h"
+
+/*
+---------------------------------------------------------------------------------
+Private Structs
+---------------------------------------------------------------------------------
+*/
+//  Decoded Format Definition
+typedef struct _decode_def_t {
+    uint8_t *fmt;
+    uint8_t nargs;
+    uint8_t types[LOG_BIN_MAX_ARGS];
+} decode_def_t;
+
+//  Global Static Variables
+static const uint8_t *logLevelNames[] = {                                                           //  Level tags indexed by level
+    "LOG_NONE", "LOG_FATAL", "LOG_ERROR", "LOG_WARN", "LOG_INFO", "LOG_DEBUG", "LOG_DEBUG_EX0", "LOG_DEBUG_EX1"
+};
+static decode_def_t decodeDefs[LOG_BIN_MAX_FORMATS];                                                //  Definitions seen in the current file
+static uint8_t decodeDigits = LOG_TS_DEFAULT;                                                       //  Sub second digits on each timestamp
+
+/*
+    Function: Read one fixed size argument out of the payload
+    pos: Current payload position, advanced past the value
+    end: End of the payload
+    out: Where to copy the value
+    size: Size of the value
+    Return: 1 on success, 0 if the payload is short
+*/
+static int32_t decode_take(const uint8_t **pos, const uint8_t *end, void *out, size_t size) {
+    if ((size_t) (end - *pos) < size) {
+        return 0;
+    }
+    memcpy(out, *pos, size);
+    *pos += size;
+    return 1;
+}
+
+/*
+    Function: Format one event the way the original printf call would have
+    out: Output buffer
+    room: Size of the output buffer
+    def: Format definition of the event
+    pos: Start of the argument payload
+    end: End of the argument payload
+    Return: Length of the message, -1 if the payload does not match the definition
+*/
+static int32_t decode_render(uint8_t *out, size_t room, const decode_def_t *def, const uint8_t *pos, const uint8_t *end) {
+    size_t used = 0;
+    uint8_t arg = 0;
+    uint8_t spec[64];
+    uint8_t str[LOG_ASYNC_RECORD_SIZE + 1];
+    for (const uint8_t *p = def->fmt; *p && used + 1 < room; p++) {
+        if (*p != '%') {
+            out[used++] = *p;
+            continue;
+        }
+        if (p[1] == '%') {
+            out[used++] = '%';
+            p++;
+            continue;
+        }
+        const uint8_t *start = p++;                                                                 //  Find the conversion character
+        while (*p && !strchr("diouxXcsfFeEgGaApnm", *p)) {
+            p++;
+        }
+        if (!*p || (size_t) (p - start + 1) >= sizeof(spec)) {
+            return -1;
+        }
+        memcpy(spec, start, p - start + 1);
+        spec[p - start + 1] = 0;
+        int stars[2];
+        uint8_t nstars = 0;
+        for (const uint8_t *q = spec; *q; q++) {                                                    //  Width and precision taken from arguments
+            if (*q == '*') {
+                if (nstars == 2 || arg >= def->nargs || !decode_take(&pos, end, &stars[nstars++], sizeof(int))) {
+                    return -1;
+                }
+                arg++;
+            }
+        }
+        if (arg >= def->nargs) {
+            return -1;
+        }
+        int32_t n;
+#define DECODE_EMIT(val)                                                                            \
+        if (nstars == 0) n = snprintf(out + used, room - used, spec, val);                          \
+        else if (nstars == 1) n = snprintf(out + used, room - used, spec, stars[0], val);           \
+        else n = snprintf(out + used, room - used, spec, stars[0], stars[1], val);
+#define DECODE_CASE(tag, type)                                                                      \
+        case tag: {                                                                                 \
+            type v;                                                                                 \
+            if (!decode_take(&pos, end, &v, sizeof(v))) {                                           \
+                return -1;                                                                          \
+            }                                                                                       \
+            DECODE_EMIT(v);                                                                         \
+            break;                                                                                  \
+        }
+        switch (def->types[arg++]) {
+            DECODE_CASE(LOG_BIN_ARG_INT, int)
+            DECODE_CASE(LOG_BIN_ARG_LONG, long)
+            DECODE_CASE(LOG_BIN_ARG_LLONG, long long)
+            DECODE_CASE(LOG_BIN_ARG_SIZE, size_t)
+            DECODE_CASE(LOG_BIN_ARG_DOUBLE, double)
+            DECODE_CASE(LOG_BIN_ARG_LDOUBLE, long double)
+            DECODE_CASE(LOG_BIN_ARG_PTR, void *)
+            case LOG_BIN_ARG_STR: {
+                uint16_t len;
+                if (!decode_take(&pos, end, &len, sizeof(len)) || len > sizeof(str) - 1 || !decode_take(&pos, end, str, len)) {
+                    return -1;
+                }
+                str[len] = 0;
+                DECODE_EMIT(str);
+                break;
+            }
+            default:
+                return -1;
+        }
+#undef DECODE_CASE
+#undef DECODE_EMIT
+        if (n < 0) {
+            return -1;
+        }
+        used += ((size_t) n < room - used) ? (size_t) n : room - used - 1;                          //  Output truncated at the buffer size
+    }
+    out[used] = 0;
+    return used;
+}
+
+/*
+    Function: Decode one binary log file to stdout
+    path: Path to the binary log
+    Return: 1 on success, -1 on error
+*/
+static int32_t decode_file(const uint8_t *path) {
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        perror(path);
+        return -1;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    uint8_t *data = malloc(size > 0 ? size : 1);
+    if (data == NULL || fread(data, 1, size, fp) != (size_t) size) {
+        fprintf(stderr, "%s: read failed\n", path);
+        free(data);
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+
+    if (size >= LOG_LZ_MAGIC_SIZE && memcmp(data, LOG_LZ_MAGIC, LOG_LZ_MAGIC_SIZE) == 0) {          //  Compressed rotated file
+        uint8_t *raw;
+        size_t raw_len;
+        if (log_lz_decompress_buffer(data, size, &raw, &raw_len) < 0) {
+            fprintf(stderr, "%s: corrupt compressed log\n", path);
+            free(data);
+            return -1;
+        }
+        free(data);
+        data = raw;
+        size = raw_len;
+        if (size < LOG_BIN_MAGIC_SIZE || memcmp(data, LOG_BIN_MAGIC, LOG_BIN_MAGIC_SIZE) != 0) {    //  Text log, nothing to decode
+            fwrite(data, 1, size, stdout);
+            free(data);
+            return 1;
+        }
+    }
+
+    const uint8_t *pos = data;
+    const uint8_t *end = data + size;
+    if (size < LOG_BIN_MAGIC_SIZE || memcmp(pos, LOG_BIN_MAGIC, LOG_BIN_MAGIC_SIZE) != 0) {         //  Truncated in place, skip to the restart
+        pos = memmem(data, size, LOG_BIN_MAGIC, LOG_BIN_MAGIC_SIZE);
+        if (pos == NULL) {
+            fprintf(stderr, "%s: not a binary log\n", path);
+            free(data);
+            return -1;
+        }
+    }
+    pos += LOG_BIN_MAGIC_SIZE;
+
+    uint8_t line[4096];
+    uint8_t ts[LOG_TIMESTAMP_SIZE];
+    while (end - pos >= 3) {                                                                        //  type and len
+        uint8_t type = pos[0];
+        uint16_t len;
+        memcpy(&len, pos + 1, sizeof(len));
+        if (type == LOG_BIN_MAGIC[0] && end - pos >= LOG_BIN_MAGIC_SIZE && memcmp(pos, LOG_BIN_MAGIC, LOG_BIN_MAGIC_SIZE) == 0) {
+            pos += LOG_BIN_MAGIC_SIZE;                                                              //  File restarted after a truncate
+            continue;
+        }
+        if (len < 3 || len > end - pos) {
+            fprintf(stderr, "%s: truncated record at offset %ld\n", path, (long) (pos - data));
+            break;
+        }
+        if (type == LOG_BIN_REC_FORMAT && len >= sizeof(log_bin_format_t)) {
+            log_bin_format_t rec;
+            memcpy(&rec, pos, sizeof(rec));
+            if (rec.id < LOG_BIN_MAX_FORMATS && rec.nargs <= LOG_BIN_MAX_ARGS) {
+                decode_def_t *def = &decodeDefs[rec.id];
+                size_t fmt_len = len - sizeof(log_bin_format_t);
+                free(def->fmt);
+                def->fmt = malloc(fmt_len + 1);
+                if (def->fmt != NULL) {
+                    memcpy(def->fmt, pos + sizeof(log_bin_format_t), fmt_len);
+                    def->fmt[fmt_len] = 0;
+                    def->nargs = rec.nargs;
+                    memcpy(def->types, rec.types, sizeof(def->types));
+                }
+            }
+        } else if (type == LOG_BIN_REC_EVENT && len >= sizeof(log_bin_event_t)) {
+            log_bin_event_t rec;
+            memcpy(&rec, pos, sizeof(rec));
+            time_t secs = rec.ts_ns / 1000000000ULL;
+            struct tm tm;
+            localtime_r(&secs, &tm);
+            size_t ts_len = strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M:%S", &tm);
+            if (decodeDigits) {
+                uint32_t frac = rec.ts_ns % 1000000000ULL;
+                for (uint8_t i = decodeDigits; i < LOG_TS_NANO; i++) {
+                    frac /= 10;
+                }
+                snprintf(ts + ts_len, sizeof(ts) - ts_len, ".%0*u", decodeDigits, frac);
+            }
+            const uint8_t *level = (rec.level < sizeof(logLevelNames) / sizeof(logLevelNames[0])) ? logLevelNames[rec.level] : (const uint8_t *) "LOG_NONE";
+            if (rec.id >= LOG_BIN_MAX_FORMATS || decodeDefs[rec.id].fmt == NULL) {
+                printf("[%s] %s: <unknown format id %u>\n", ts, level, rec.id);
+            } else if (decode_render(line, sizeof(line), &decodeDefs[rec.id], pos + sizeof(log_bin_event_t), pos + len) < 0) {
+                printf("[%s] %s: <bad arguments for \"%s\">\n", ts, level, decodeDefs[rec.id].fmt);
+            } else {
+                printf("[%s] %s: %s\n", ts, level, line);
+            }
+        }
+        pos += len;
+    }
+
+    for (uint32_t i = 0; i < LOG_BIN_MAX_FORMATS; i++) {                                            //  Each file carries its own definitions
+        free(decodeDefs[i].fmt);
+        decodeDefs[i].fmt = NULL;
+    }
+    free(data);
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    int32_t first = 1;
+    if (argc > 2 && strcmp(argv[1], "-p") == 0) {
+        int32_t digits = atoi(argv[2]);
+        decodeDigits = (digits < 0) ? 0 : (digits > LOG_TS_NANO) ? LOG_TS_NANO : digits;
+        first = 3;
+    }
+    if (argc <= first) {
+        fprintf(stderr, "usage: %s [-p digits] <binary log> [<binary log> ...]\n", argv[0]);
+        return 1;
+    }
+    int32_t status = 0;
+    for (int32_t i = first; i < argc; i++) {
+        if (decode_file(argv[i]) < 0) {
+            status = 1;
+        }
+    }
+    return status;
+}
@@ -3,6 +3,211 @@
 
 static uint8_t errorArray[120] = {0};                                                               //  Error array to help print specific function
 
+/*
+    Function: Send every byte, looping over short sends
+    fd: Socket to send on
+    send_msg: Send Message Buffer
+    send_len: Send Message Buffer Length
+    flags: send flags
+*/
+static int32_t TCP_send_all(int32_t fd, const uint8_t *send_msg, uint32_t send_len, int32_t flags) {
+    uint32_t sent = 0;
+    while (sent < send_len) {
+        ssize_t sentBytes = send(fd, send_msg + sent, send_len - sent, flags | MSG_NOSIGNAL);       //  Closed peer gives an error, not SIGPIPE
+        if (sentBytes < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        sent += sentBytes;
+    }
+    return 1;
+}
+
+/*
+    Function: Hand out bytes already in the read buffer
+    tcp_info: Struct that hold file descriptor and addr information
+    recv_buff: Receive Message Buffer
+    recv_len: Receive Message Buffer Length
+    Return: Bytes copied
+*/
+static int32_t TCP_read_buffered(tcp_info_t *tcp_info, uint8_t *recv_buff, uint32_t recv_len) {
+    uint32_t avail = tcp_info->read_len - tcp_info->read_head;
+    uint32_t take = (avail < recv_len) ? avail : recv_len;
+    memcpy(recv_buff, tcp_info->read_buff + tcp_info->read_head, take);
+    tcp_info->read_head += take;
+    if (tcp_info->read_head == tcp_info->read_len) {                                                //  Empty, start over at the front
+        tcp_info->read_head = tcp_info->read_len = 0;
+    }
+    return take;
+}
+
+/*
+    Function: Receive until the read buffer holds need bytes. Each recv asks for all the free room,
+              so one call usually brings in many small frames at once
+    tcp_info: Struct that hold file descriptor and addr information
+    fd: Socket to read
+    need: Bytes wanted in the buffer
+    deadline: Give up at this time, NULL waits forever
+    Return: 1 when the bytes are there, 0 on timeout, -1 on error or a closed peer
+*/
+static int32_t TCP_read_fill(tcp_info_t *tcp_info, int32_t fd, uint32_t need, const struct timeval *deadline) {
+    if (need > tcp_info->read_cap) {                                                                //  Grow for a large frame
+        uint32_t cap = tcp_info->read_cap ? tcp_info->read_cap : TCP_READ_BUFF_SIZE;
+        while (cap < need) {
+            cap *= 2;
+        }
+        uint8_t *read_buff = realloc(tcp_info->read_buff, cap);
+        if (read_buff == NULL) {
+            snprintf(errorArray, sizeof(errorArray), "%s: Allocate Read Buffer\n", __FUNCTION__);  //  Populate Error Array
+            perror(errorArray);                                                                     //  Print out this if it failed
+            return -1;                                                                              //  Return error
+        }
+        tcp_info->read_buff = read_buff;
+        tcp_info->read_cap = cap;
+    }
+    if (tcp_info->read_head + need > tcp_info->read_cap) {                                          //  Move the partial frame to the front
+        memmove(tcp_info->read_buff, tcp_info->read_buff + tcp_info->read_head, tcp_info->read_len - tcp_info->read_head);
+        tcp_info->read_len -= tcp_info->read_head;
+        tcp_info->read_head = 0;
+    }
+    while (tcp_info->read_len - tcp_info->read_head < need) {
+        if (deadline != NULL) {
+            struct timeval now, timeout;
+            gettimeofday(&now, NULL);
+            if (!timercmp(&now, deadline, <)) {
+                return 0;
+            }
+            timersub(deadline, &now, &timeout);
+            fd_set reading;                                                                         //  Initialize data struct for fd set
+            FD_ZERO(&reading);                                                                      //  Set reading struct to 0
+            FD_SET(fd, &reading);                                                                   //  Set reading struct to monitor fd
+            int32_t ready = select(fd + 1, &reading, NULL, NULL, &timeout);                         //  Wait until fd has a message or timeout
+            if (ready < 0 && errno != EINTR) {
+                snprintf(errorArray, sizeof(errorArray), "%s: Select() Failed\n", __FUNCTION__);    //  Populate Error Array
+                perror(errorArray);                                                                 //  Print out this if it failed
+                return -1;                                                                          //  Return error
+            }
+            if (ready <= 0) {
+                continue;
+            }
+        }
+        ssize_t recvBytes = recv(fd, tcp_info->read_buff + tcp_info->read_len, tcp_info->read_cap - tcp_info->read_len, 0);
+        if (recvBytes < 0 && errno == EINTR) {
+            continue;
+        }
+        if (recvBytes <= 0) {                                                                       //  Peer closed or error
+            return -1;
+        }
+        tcp_info->read_len += recvBytes;
+    }
+    return 1;
+}
+
+/*
+    Function: Receive exactly recv_len bytes, read buffer first
+    tcp_info: Struct that hold file descriptor and addr information
+    fd: Socket to read
+    recv_buff: Receive Message Buffer
+    recv_len: Bytes wanted
+*/
+static int32_t TCP_recv_all(tcp_info_t *tcp_info, int32_t fd, uint8_t *recv_buff, uint32_t recv_len) {
+    uint32_t got = 0;
+    if (tcp_info->read_len > tcp_info->read_head) {
+        got = TCP_read_buffered(tcp_info, recv_buff, recv_len);
+    }
+    while (got < recv_len) {                                                                        //  Straight into the caller's buffer, no copy
+        ssize_t recvBytes = recv(fd, recv_buff + got, recv_len - got, MSG_WAITALL);
+        if (recvBytes < 0 && errno == EINTR) {
+            continue;
+        }
+        if (recvBytes <= 0) {
+            snprintf(errorArray, sizeof(errorArray), "%s: Connection Closed or Failed\n", __FUNCTION__);  //  Populate Error Array
+            perror(errorArray);                                                                     //  Print out this if it failed
+            return -1;                                                                              //  Return error
+        }
+        got += recvBytes;
+    }
+    return got;
+}
+
+/*
+    Function: Send one frame, a big endian length followed by the payload
+    fd: Socket to send on
+    send_msg: Frame payload
+    send_len: Frame payload length
+*/
+static int32_t TCP_send_frame(int32_t fd, const uint8_t *send_msg, uint32_t send_len) {
+    uint8_t frame[TCP_FRAME_HEADER_SIZE + TCP_FRAME_COPY_SIZE];
+    uint32_t len_be = htonl(send_len);
+    memcpy(frame, &len_be, TCP_FRAME_HEADER_SIZE);
+    if (send_len <= TCP_FRAME_COPY_SIZE) {                                                          //  Small frame, header and payload in one send
+        memcpy(frame + TCP_FRAME_HEADER_SIZE, send_msg, send_len);
+        return TCP_send_all(fd, frame, TCP_FRAME_HEADER_SIZE + send_len, 0);
+    }
+    if (TCP_send_all(fd, frame, TCP_FRAME_HEADER_SIZE, MSG_MORE) < 0) {                             //  MSG_MORE holds the header for the payload
+        return -1;
+    }
+    return TCP_send_all(fd, send_msg, send_len, 0);
+}
+
+/*
+    Function: Receive one frame. The length and payload are cut from the read buffer, bytes past
+              the frame stay there for the next call. A timeout keeps any partial frame
+    tcp_info: Struct that hold file descriptor and addr information
+    fd: Socket to read
+    recv_buff: Receive Message Buffer
+    recv_len: Receive Message Buffer Length
+    deadline: Give up at this time, NULL waits forever
+    Return: Payload length, -1 on error or timeout, -2 if the connection closed or failed
+*/
+static int32_t TCP_recv_frame(tcp_info_t *tcp_info, int32_t fd, uint8_t *recv_buff, uint32_t recv_len, const struct timeval *deadline) {
+    int32_t status = TCP_read_fill(tcp_info, fd, TCP_FRAME_HEADER_SIZE, deadline);
+    uint32_t len_be = 0;
+    if (status > 0) {
+        memcpy(&len_be, tcp_info->read_buff + tcp_info->read_head, TCP_FRAME_HEADER_SIZE);
+        if (ntohl(len_be) > TCP_FRAME_MAX_SIZE) {
+            snprintf(errorArray, sizeof(errorArray), "%s: Frame Length Out Of Range\n", __FUNCTION__);  //  Populate Error Array
+            perror(errorArray);                                                                     //  Print out this if it failed
+            return -2;                                                                              //  Return connection error, stream is out of sync
+        }
+        status = TCP_read_fill(tcp_info, fd, TCP_FRAME_HEADER_SIZE + ntohl(len_be), deadline);
+    }
+    if (status == 0) {
+        printf("%s: Timeout Occurred\n", __FUNCTION__);                                             //  Print Timeout
+        return -1;
+    }
+    if (status < 0) {
+        snprintf(errorArray, sizeof(errorArray), "%s: Connection Closed or Failed\n", __FUNCTION__);  //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        return -2;                                                                                  //  Return connection error
+    }
+    uint32_t frame_len = ntohl(len_be);
+    tcp_info->read_head += TCP_FRAME_HEADER_SIZE;
+    if (frame_len > recv_len) {                                                                     //  Skip it so the stream stays in sync
+        tcp_info->read_head += frame_len;
+        snprintf(errorArray, sizeof(errorArray), "%s: Frame Larger Than Buffer\n", __FUNCTION__);  //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        return -1;                                                                                  //  Return error
+    }
+    return TCP_read_buffered(tcp_info, recv_buff, frame_len);
+}
+
+/*
+    Function: Turn a soft blocking timeout into a deadline
+    deadline: Filled with now plus the timeout
+    secs: Timeout seconds
+    usecs: Timeout useconds
+*/
+static void TCP_deadline(struct timeval *deadline, uint32_t secs, uint32_t usecs) {
+    struct timeval now, timeout;
+    gettimeofday(&now, NULL);
+    timeout.tv_sec = secs + usecs / 1000000;
+    timeout.tv_usec = usecs % 1000000;
+    timeradd(&now, &timeout, deadline);
+}
+
 /*
     Function: Initialize TCP Client struct and connection.
     tcp_info: Struct that hold file descriptor and addr information
@@ -10,6 +215,8 @@ static uint8_t errorArray[120] = {0};
     port: Port that it is using (Range: 0 - 65535)
 */
 int32_t TCP_client_init(tcp_info_t *tcp_info, const uint8_t *ip, uint16_t port) {
+    tcp_info->read_buff = NULL;                                                                     //  Read buffer allocated on first frame read
+    tcp_info->read_head = tcp_info->read_len = tcp_info->read_cap = 0;
     if (TCP_validate_ip(ip) < 0) {                                                                  //  Check for valid IP
         snprintf(errorArray, sizeof(errorArray), "%s: Invalid IP Address\n", __FUNCTION__);         //  Populate Error Array
         perror(errorArray);                                                                         //  Print out this if it failed
@@ -52,8 +259,7 @@ int32_t TCP_client_init(tcp_info_t *tcp_info, const uint8_t *ip, uint16_t port)
     send_len: Send Message Buffer Length
 */
 int32_t TCP_client_send(tcp_info_t *tcp_info, uint8_t *send_msg, uint32_t send_len) {
-    ssize_t sentBytes = send(tcp_info->socket_fd, send_msg, send_len, 0);                           //  Send message using client to server socket
-    if (sentBytes < 0) {                                                                            //  If sentBytes flag is invalid
+    if (TCP_send_all(tcp_info->socket_fd, send_msg, send_len, 0) < 0) {                             //  Send whole message using client to server socket
         snprintf(errorArray, sizeof(errorArray), "%s: Error Sending", __FUNCTION__);                //  Populate Error Array
         perror(errorArray);                                                                         //  Print out this if it failed
         return -1;                                                                                  //  Return error
@@ -68,6 +274,9 @@ int32_t TCP_client_send(tcp_info_t *tcp_info, uint8_t *send_msg, uint32_t send_l
     recv_len: Receive Message Buffer Length
 */
 int32_t TCP_client_recv_blocking(tcp_info_t *tcp_info, uint8_t *recv_buff, uint32_t recv_len) {
+    if (tcp_info->read_len > tcp_info->read_head) {                                                 //  Bytes left over from a frame read come first
+        return TCP_read_buffered(tcp_info, recv_buff, recv_len);
+    }
     fd_set reading;                                                                                 //  Initialize data struct for fd set
     FD_ZERO(&reading);                                                                              //  Set reading struct to 0
     FD_SET(tcp_info->socket_fd, &reading);                                                          //  Set reading struct to monitor socket_fd
@@ -98,6 +307,9 @@ int32_t TCP_client_recv_blocking(tcp_info_t *tcp_info, uint8_t *recv_buff, uint3
     usecs: Timeout useconds
 */
 int32_t TCP_client_recv_soft_blocking(tcp_info_t *tcp_info, uint8_t *recv_buff, uint32_t recv_len, uint32_t secs, uint32_t usecs) {
+    if (tcp_info->read_len > tcp_info->read_head) {                                                 //  Bytes left over from a frame read come first
+        return TCP_read_buffered(tcp_info, recv_buff, recv_len);
+    }
     fd_set reading;                                                                                 //  Initialize data struct for fd set
     FD_ZERO(&reading);                                                                              //  Set reading struct to 0
     FD_SET(tcp_info->socket_fd, &reading);                                                          //  Set reading struct to monitor socket_fd
@@ -132,6 +344,8 @@ int32_t TCP_client_recv_soft_blocking(tcp_info_t *tcp_info, uint8_t *recv_buff,
     port: Port that it is using (Range: 0 - 65535)
 */
 int32_t TCP_server_any_ip_init(tcp_info_t *tcp_info, uint16_t port) { 
+    tcp_info->read_buff = NULL;                                                                     //  Read buffer allocated on first frame read
+    tcp_info->read_head = tcp_info->read_len = tcp_info->read_cap = 0;
     if ((tcp_info->socket_fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) < 0) {                    //  Initialize server socket
         snprintf(errorArray, sizeof(errorArray), "%s: Socket Creation Failed\n", __FUNCTION__);     //  Populate Error Array
         perror(errorArray);                                                                         //  Print out this if it failed
@@ -170,6 +384,8 @@ int32_t TCP_server_any_ip_init(tcp_info_t *tcp_info, uint16_t port) {
     port: Port that it is using (Range: 0 - 65535)
 */
 int32_t TCP_server_bind_ip_init(tcp_info_t *tcp_info, const uint8_t *ip, uint16_t port) { 
+    tcp_info->read_buff = NULL;                                                                     //  Read buffer allocated on first frame read
+    tcp_info->read_head = tcp_info->read_len = tcp_info->read_cap = 0;
     if ((tcp_info->socket_fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) < 0) {                    //  Initialize server socket
         snprintf(errorArray, sizeof(errorArray), "%s: Socket Creation Failed\n", __FUNCTION__);     //  Populate Error Array
         perror(errorArray);                                                                         //  Print out this if it failed
@@ -207,8 +423,7 @@ int32_t TCP_server_bind_ip_init(tcp_info_t *tcp_info, const uint8_t *ip, uint16_
     send_len: Send Message Buffer Length
 */
 int32_t TCP_server_send(tcp_info_t *tcp_info, uint8_t *send_msg, uint32_t send_len) {
-    ssize_t sentBytes = send(tcp_info->client_fd, send_msg, send_len, 0);                           //  Send message using server to client socket
-    if (sentBytes < 0) {                                                                            //  If sentBytes flag is invalid
+    if (TCP_send_all(tcp_info->client_fd, send_msg, send_len, 0) < 0) {                             //  Send whole message using server to client socket
         snprintf(errorArray, sizeof(errorArray), "%s: Error Sending\n", __FUNCTION__);              //  Populate Error Array
         perror(errorArray);                                                                         //  Print out this if it failed
         return -1;                                                                                  //  Return error
@@ -223,6 +438,9 @@ int32_t TCP_server_send(tcp_info_t *tcp_info, uint8_t *send_msg, uint32_t send_l
     recv_len: Receive Message Buffer Length
 */
 int32_t TCP_server_recv_blocking(tcp_info_t *tcp_info, uint8_t *recv_buff, uint32_t recv_len) {
+    if (tcp_info->read_len > tcp_info->read_head) {                                                 //  Bytes left over from a frame read come first
+        return TCP_read_buffered(tcp_info, recv_buff, recv_len);
+    }
     fd_set reading;                                                                                 //  Initialize data struct for fd set
     FD_ZERO(&reading);                                                                              //  Set reading struct to 0
     FD_SET(tcp_info->client_fd, &reading);                                                          //  Set reading struct to monitor socket_fd
@@ -257,6 +475,9 @@ int32_t TCP_server_recv_blocking(tcp_info_t *tcp_info, uint8_t *recv_buff, uint3
     usecs: Timeout useconds
 */
 int32_t TCP_server_recv_soft_blocking(tcp_info_t *tcp_info, uint8_t *recv_buff, uint32_t recv_len, uint32_t secs, uint32_t usecs) {
+    if (tcp_info->read_len > tcp_info->read_head) {                                                 //  Bytes left over from a frame read come first
+        return TCP_read_buffered(tcp_info, recv_buff, recv_len);
+    }
     fd_set reading;                                                                                 //  Initialize data struct for fd set
     FD_ZERO(&reading);                                                                              //  Set reading struct to 0
     FD_SET(tcp_info->client_fd, &reading);                                                          //  Set reading struct to monitor socket_fd
@@ -312,6 +533,7 @@ int32_t TCP_server_accept_blocking(tcp_info_t *tcp_info) {
             }
             else {
                 tcp_info->client_known = 1;                                                         //  Set client known to true
+                tcp_info->read_head = tcp_info->read_len = 0;                                       //  Drop bytes left from the last client
                 memcpy(&tcp_info->client_addr_info, &addr_info, tcp_info->client_addr_len);         //  Copy addr info to struct
                 acceptFlag = 1;                                                                     //  Set acceptFlag to good
             }
@@ -347,6 +569,7 @@ int32_t TCP_server_accept_soft_blocking(tcp_info_t *tcp_info, uint32_t secs, uin
             }
             else {
                 tcp_info->client_known = 1;                                                         //  Set client known to true
+                tcp_info->read_head = tcp_info->read_len = 0;                                       //  Drop bytes left from the last client
                 memcpy(&tcp_info->client_addr_info, &addr_info, tcp_info->client_addr_len);         //  Copy addr info to struct
                 acceptFlag = 1;                                                                     //  Set acceptFlag to good
             }
@@ -355,6 +578,121 @@ int32_t TCP_server_accept_soft_blocking(tcp_info_t *tcp_info, uint32_t secs, uin
     return acceptFlag;                                                                              //  Return accept flag
 }
 
+/*
+    Function: Receive exactly recv_len TCP client bytes, blocking until they all arrive
+    tcp_info: Struct that hold file descriptor and addr information
+    recv_buff: Receive Message Buffer
+    recv_len: Bytes wanted
+*/
+int32_t TCP_client_recv_all(tcp_info_t *tcp_info, uint8_t *recv_buff, uint32_t recv_len) {
+    return TCP_recv_all(tcp_info, tcp_info->socket_fd, recv_buff, recv_len);
+}
+
+/*
+    Function: Receive exactly recv_len TCP server bytes, blocking until they all arrive
+    tcp_info: Struct that hold file descriptor and addr information
+    recv_buff: Receive Message Buffer
+    recv_len: Bytes wanted
+*/
+int32_t TCP_server_recv_all(tcp_info_t *tcp_info, uint8_t *recv_buff, uint32_t recv_len) {
+    int32_t recvBytes = TCP_recv_all(tcp_info, tcp_info->client_fd, recv_buff, recv_len);
+    if (recvBytes < 0) {                                                                            //  Client disconnected
+        close(tcp_info->client_fd);                                                                 //  Close client socket fd
+        tcp_info->client_known = 0;                                                                 //  Set clientKnown to false
+    }
+    return recvBytes;
+}
+
+/*
+    Function: Send one length prefixed TCP client frame, all of it
+    tcp_info: Struct that hold file descriptor and addr information
+    send_msg: Frame payload
+    send_len: Frame payload length (up to TCP_FRAME_MAX_SIZE)
+*/
+int32_t TCP_client_send_frame(tcp_info_t *tcp_info, const uint8_t *send_msg, uint32_t send_len) {
+    if (send_len > TCP_FRAME_MAX_SIZE || TCP_send_frame(tcp_info->socket_fd, send_msg, send_len) < 0) {
+        snprintf(errorArray, sizeof(errorArray), "%s: Error Sending\n", __FUNCTION__);              //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        return -1;                                                                                  //  Return error
+    }
+    return 1;                                                                                       //  Return good
+}
+
+/*
+    Function: Send one length prefixed TCP server frame, all of it
+    tcp_info: Struct that hold file descriptor and addr information
+    send_msg: Frame payload
+    send_len: Frame payload length (up to TCP_FRAME_MAX_SIZE)
+*/
+int32_t TCP_server_send_frame(tcp_info_t *tcp_info, const uint8_t *send_msg, uint32_t send_len) {
+    if (send_len > TCP_FRAME_MAX_SIZE || TCP_send_frame(tcp_info->client_fd, send_msg, send_len) < 0) {
+        snprintf(errorArray, sizeof(errorArray), "%s: Error Sending\n", __FUNCTION__);              //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        return -1;                                                                                  //  Return error
+    }
+    return 1;                                                                                       //  Return good
+}
+
+/*
+    Function: Receive one whole TCP client frame and have read as blocking
+    tcp_info: Struct that hold file descriptor and addr information
+    recv_buff: Receive Message Buffer
+    recv_len: Receive Message Buffer Length, larger frames are skipped with an error
+*/
+int32_t TCP_client_recv_frame_blocking(tcp_info_t *tcp_info, uint8_t *recv_buff, uint32_t recv_len) {
+    int32_t recvBytes = TCP_recv_frame(tcp_info, tcp_info->socket_fd, recv_buff, recv_len, NULL);
+    return (recvBytes < 0) ? -1 : recvBytes;
+}
+
+/*
+    Function: Receive one whole TCP client frame and have read as non blocking
+    tcp_info: Struct that hold file descriptor and addr information
+    recv_buff: Receive Message Buffer
+    recv_len: Receive Message Buffer Length, larger frames are skipped with an error
+    secs: Timeout seconds for the whole frame
+    usecs: Timeout useconds for the whole frame
+*/
+int32_t TCP_client_recv_frame_soft_blocking(tcp_info_t *tcp_info, uint8_t *recv_buff, uint32_t recv_len, uint32_t secs, uint32_t usecs) {
+    struct timeval deadline;
+    TCP_deadline(&deadline, secs, usecs);
+    int32_t recvBytes = TCP_recv_frame(tcp_info, tcp_info->socket_fd, recv_buff, recv_len, &deadline);
+    return (recvBytes < 0) ? -1 : recvBytes;
+}
+
+/*
+    Function: Receive one whole TCP server frame and have read as blocking
+    tcp_info: Struct that hold file descriptor and addr information
+    recv_buff: Receive Message Buffer
+    recv_len: Receive Message Buffer Length, larger frames are skipped with an error
+*/
+int32_t TCP_server_recv_frame_blocking(tcp_info_t *tcp_info, uint8_t *recv_buff, uint32_t recv_len) {
+    int32_t recvBytes = TCP_recv_frame(tcp_info, tcp_info->client_fd, recv_buff, recv_len, NULL);
+    if (recvBytes == -2) {                                                                          //  Client disconnected
+        close(tcp_info->client_fd);                                                                 //  Close client socket fd
+        tcp_info->client_known = 0;                                                                 //  Set clientKnown to false
+    }
+    return (recvBytes < 0) ? -1 : recvBytes;
+}
+
+/*
+    Function: Receive one whole TCP server frame and have read as non blocking
+    tcp_info: Struct that hold file descriptor and addr information
+    recv_buff: Receive Message Buffer
+    recv_len: Receive Message Buffer Length, larger frames are skipped with an error
+    secs: Timeout seconds for the whole frame
+    usecs: Timeout useconds for the whole frame
+*/
+int32_t TCP_server_recv_frame_soft_blocking(tcp_info_t *tcp_info, uint8_t *recv_buff, uint32_t recv_len, uint32_t secs, uint32_t usecs) {
+    struct timeval deadline;
+    TCP_deadline(&deadline, secs, usecs);
+    int32_t recvBytes = TCP_recv_frame(tcp_info, tcp_info->client_fd, recv_buff, recv_len, &deadline);
+    if (recvBytes == -2) {                                                                          //  Client disconnected
+        close(tcp_info->client_fd);                                                                 //  Close client socket fd
+        tcp_info->client_known = 0;                                                                 //  Set clientKnown to false
+    }
+    return (recvBytes < 0) ? -1 : recvBytes;
+}
+
 /*
     Function: Close file descriptors
     tcp_info: Struct that hold file descriptor and addr information
@@ -362,6 +700,9 @@ int32_t TCP_server_accept_soft_blocking(tcp_info_t *tcp_info, uint32_t secs, uin
 void TCP_close(tcp_info_t *tcp_info) {
     close(tcp_info->client_fd);                                                                     //  Close client socket
     close(tcp_info->socket_fd);                                                                     //  Close server socket
+    free(tcp_info->read_buff);                                                                      //  Free read buffer
+    tcp_info->read_buff = NULL;
+    tcp_info->read_head = tcp_info->read_len = tcp_info->read_cap = 0;
 }
 
 /*
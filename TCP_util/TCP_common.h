@@ -14,11 +14,17 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/select.h>
+#include <sys/time.h>
+#include <errno.h>
 #include <termios.h>
 #include <ctype.h>
 
 //  TCP Misc.
 #define MAX_CLIENT_CONNECTIONS              (1)
+#define TCP_READ_BUFF_SIZE                  (64 * 1024)     //  Read buffer size, one recv fills as much of it as it can
+#define TCP_FRAME_HEADER_SIZE               (4)             //  Big endian payload length before every frame
+#define TCP_FRAME_MAX_SIZE                  (16 * 1024 * 1024)  //  Larger lengths mean the stream is out of sync
+#define TCP_FRAME_COPY_SIZE                 (1024)          //  Frames up to this go out in one send with their header
 
 //  TCP Information Struct
 typedef struct _tcp_info_t {
@@ -29,6 +35,10 @@ typedef struct _tcp_info_t {
     uint8_t client_known;
     struct sockaddr_in addr_info;
     struct sockaddr_in client_addr_info;
+    uint8_t *read_buff;                                                                             //  Bytes received ahead of the caller, frames are cut from here
+    uint32_t read_head;
+    uint32_t read_len;
+    uint32_t read_cap;
 } tcp_info_t, *p_tcp_info_t;
 
 
@@ -44,6 +54,14 @@ int32_t TCP_server_recv_blocking(tcp_info_t *tcp_info, uint8_t *recv_buff, uint3
 int32_t TCP_server_recv_soft_blocking(tcp_info_t *tcp_info, uint8_t *recv_buff, uint32_t recv_len, uint32_t secs, uint32_t usecs);
 int32_t TCP_server_accept_blocking(tcp_info_t *tcp_info);
 int32_t TCP_server_accept_soft_blocking(tcp_info_t *tcp_info, uint32_t secs, uint32_t usecs);
+int32_t TCP_client_recv_all(tcp_info_t *tcp_info, uint8_t *recv_buff, uint32_t recv_len);
+int32_t TCP_server_recv_all(tcp_info_t *tcp_info, uint8_t *recv_buff, uint32_t recv_len);
+int32_t TCP_client_send_frame(tcp_info_t *tcp_info, const uint8_t *send_msg, uint32_t send_len);
+int32_t TCP_server_send_frame(tcp_info_t *tcp_info, const uint8_t *send_msg, uint32_t send_len);
+int32_t TCP_client_recv_frame_blocking(tcp_info_t *tcp_info, uint8_t *recv_buff, uint32_t recv_len);
+int32_t TCP_client_recv_frame_soft_blocking(tcp_info_t *tcp_info, uint8_t *recv_buff, uint32_t recv_len, uint32_t secs, uint32_t usecs);
+int32_t TCP_server_recv_frame_blocking(tcp_info_t *tcp_info, uint8_t *recv_buff, uint32_t recv_len);
+int32_t TCP_server_recv_frame_soft_blocking(tcp_info_t *tcp_info, uint8_t *recv_buff, uint32_t recv_len, uint32_t secs, uint32_t usecs);
 void TCP_close(tcp_info_t *tcp_info);
 int32_t TCP_validate_ip(const uint8_t *ip);
 
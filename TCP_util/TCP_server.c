@@ -0,0 +1,417 @@
+#define _GNU_SOURCE
+
+//  Developed Libraries
+#include "TCP_server.h"
+
+static uint8_t errorArray[120] = {0};                                                               //  Error array to help print specific function
+
+/*
+    Function: Raise the open file limit so the pool can hold every client
+    needed: File descriptors wanted
+*/
+static void TCP_server_raise_fd_limit(rlim_t needed) {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < needed) {
+        limit.rlim_cur = (limit.rlim_max == RLIM_INFINITY || limit.rlim_max > needed) ? needed : limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);                                                           //  Best effort, accept fails cleanly past it
+    }
+}
+
+/*
+    Function: Initialize the epoll TCP server, listen socket and connection pool
+    server: Struct that hold file descriptors and connection pool
+    ip: IP address to bind in X.X.X.X (127.0.0.1), NULL for all interfaces
+    port: Port that it is using (Range: 0 - 65535)
+    max_conns: Most clients connected at once
+*/
+int32_t TCP_server_init(tcp_server_t *server, const uint8_t *ip, uint16_t port, uint32_t max_conns) {
+    memset(server, 0, sizeof(tcp_server_t));
+    server->socket_fd = -1;
+    server->epoll_fd = -1;
+    server->wake_fd = -1;
+    if (max_conns == 0 || (ip != NULL && TCP_validate_ip(ip) <= 0)) {                               //  Check for valid IP
+        snprintf(errorArray, sizeof(errorArray), "%s: Invalid IP Address or Pool Size\n", __FUNCTION__);  //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        return -1;                                                                                  //  Return error
+    }
+
+    server->max_conns = max_conns;
+    server->conns = calloc(max_conns, sizeof(tcp_conn_t));
+    server->free_list = malloc(max_conns * sizeof(uint32_t));
+    server->close_list = malloc(max_conns * sizeof(tcp_conn_t *));
+    server->events = malloc(TCP_SERVER_MAX_EVENTS * sizeof(struct epoll_event));
+    server->recv_buff = malloc(TCP_SERVER_RECV_SIZE);
+    if (server->conns == NULL || server->free_list == NULL || server->close_list == NULL || server->events == NULL || server->recv_buff == NULL) {
+        snprintf(errorArray, sizeof(errorArray), "%s: Allocate Connection Pool\n", __FUNCTION__);   //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        TCP_server_close(server);
+        return -1;                                                                                  //  Return error
+    }
+    for (uint32_t i = 0; i < max_conns; i++) {                                                      //  Hand out low slots first
+        server->conns[i].fd = -1;
+        server->conns[i].index = i;
+        server->free_list[i] = max_conns - 1 - i;
+    }
+    server->free_count = max_conns;
+    TCP_server_raise_fd_limit((rlim_t) max_conns + 64);
+
+    if ((server->socket_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP)) < 0) {  //  Initialize server socket
+        snprintf(errorArray, sizeof(errorArray), "%s: Socket Creation Failed\n", __FUNCTION__);     //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        TCP_server_close(server);
+        return -1;                                                                                  //  Return error
+    }
+    int32_t reuse = 1;
+    setsockopt(server->socket_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));                 //  Restart without waiting out TIME_WAIT
+
+    struct sockaddr_in addr_info = {0};                                                             //  Initialize temp addr_info struct
+    addr_info.sin_family = AF_INET;                                                                 //  Set address family to ipv4 address
+    addr_info.sin_addr.s_addr = (ip == NULL) ? htonl(INADDR_ANY) : inet_addr(ip);                   //  Set ip address
+    addr_info.sin_port = htons(port);                                                               //  Set port family to host to network short
+    if (bind(server->socket_fd, (struct sockaddr*) &addr_info, sizeof(addr_info)) != 0) {           //  Bind socket to TCP incoming address requirements
+        snprintf(errorArray, sizeof(errorArray), "%s: Socket Bind Failed", __FUNCTION__);           //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        TCP_server_close(server);
+        return -1;                                                                                  //  Return error
+    }
+    if (listen(server->socket_fd, SOMAXCONN) != 0) {                                                //  Full backlog, bursts of connects are expected
+        snprintf(errorArray, sizeof(errorArray), "%s: Listen Failed", __FUNCTION__);                //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        TCP_server_close(server);
+        return -1;                                                                                  //  Return error
+    }
+    memcpy(&server->addr_info, &addr_info, sizeof(addr_info));                                      //  Copy address information to server
+
+    struct epoll_event event = {0};
+    if ((server->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0 || (server->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+        snprintf(errorArray, sizeof(errorArray), "%s: Epoll Creation Failed\n", __FUNCTION__);      //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        TCP_server_close(server);
+        return -1;                                                                                  //  Return error
+    }
+    event.events = EPOLLIN | EPOLLET;
+    event.data.ptr = NULL;                                                                          //  NULL marks the listen socket
+    int32_t status = epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->socket_fd, &event);
+    event.data.ptr = server;                                                                        //  The server itself marks the wake up
+    if (status < 0 || epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->wake_fd, &event) < 0) {
+        snprintf(errorArray, sizeof(errorArray), "%s: Epoll Add Failed\n", __FUNCTION__);           //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        TCP_server_close(server);
+        return -1;                                                                                  //  Return error
+    }
+    atomic_init(&server->running, 1);
+    return 1;                                                                                       //  Return good
+}
+
+/*
+    Function: Set the callbacks, call before the first TCP_server_poll
+    server: Struct that hold file descriptors and connection pool
+    on_accept: New client, may be NULL
+    on_read: Bytes received, may be NULL
+    on_write: Send queue drained, may be NULL
+    on_close: Client closing, may be NULL
+    user: Caller data kept in server->user
+*/
+void TCP_server_set_callbacks(tcp_server_t *server, tcp_accept_cb_t on_accept, tcp_read_cb_t on_read, tcp_write_cb_t on_write, tcp_close_cb_t on_close, void *user) {
+    server->on_accept = on_accept;
+    server->on_read = on_read;
+    server->on_write = on_write;
+    server->on_close = on_close;
+    server->user = user;
+}
+
+/*
+    Function: Close a client once the current batch of events is done, so later events in the
+              batch never see a reused slot. Safe to call from any callback
+    server: Struct that hold file descriptors and connection pool
+    conn: Client to close
+*/
+void TCP_server_conn_close(tcp_server_t *server, tcp_conn_t *conn) {
+    if (conn->fd < 0 || conn->closing) {
+        return;
+    }
+    conn->closing = 1;
+    server->close_list[server->close_count++] = conn;
+}
+
+/*
+    Function: Close the clients queued by TCP_server_conn_close and return their slots
+    server: Struct that hold file descriptors and connection pool
+*/
+static void TCP_server_reap(tcp_server_t *server) {
+    for (uint32_t i = 0; i < server->close_count; i++) {
+        tcp_conn_t *conn = server->close_list[i];
+        if (server->on_close != NULL) {
+            server->on_close(server, conn);
+        }
+        close(conn->fd);                                                                            //  Also drops it from the epoll set
+        free(conn->send_buff);
+        uint32_t index = conn->index;
+        memset(conn, 0, sizeof(tcp_conn_t));
+        conn->fd = -1;
+        conn->index = index;
+        server->free_list[server->free_count++] = index;
+        server->conn_count--;
+    }
+    server->close_count = 0;
+}
+
+/*
+    Function: Accept every pending client, edge triggered so the backlog must be drained
+    server: Struct that hold file descriptors and connection pool
+*/
+static void TCP_server_accept(tcp_server_t *server) {
+    while (1) {
+        struct sockaddr_in addr_info = {0};                                                         //  Initialize temp addr_info struct
+        socklen_t addr_len = sizeof(addr_info);
+        int32_t fd = accept4(server->socket_fd, (struct sockaddr*) &addr_info, &addr_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {                                          //  Out of fds, the client stays in the backlog
+                snprintf(errorArray, sizeof(errorArray), "%s: Accept Failed", __FUNCTION__);        //  Populate Error Array
+                perror(errorArray);                                                                 //  Print out this if it failed
+            }
+            return;
+        }
+        if (server->free_count == 0) {                                                              //  Pool full, refuse instead of replacing
+            close(fd);
+            continue;
+        }
+        int32_t nodelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));                        //  Small replies go out without waiting
+        tcp_conn_t *conn = &server->conns[server->free_list[--server->free_count]];
+        conn->fd = fd;
+        memcpy(&conn->addr_info, &addr_info, sizeof(addr_info));
+        server->conn_count++;
+        struct epoll_event event = {0};
+        event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;                                    //  Registered once, edge triggered needs no re-arm
+        event.data.ptr = conn;
+        if ((server->on_accept != NULL && server->on_accept(server, conn) < 0) || epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+            TCP_server_conn_close(server, conn);
+        }
+    }
+}
+
+/*
+    Function: Read a client until the socket is empty, edge triggered gives no second event.
+              A short read ends the loop without another recv, unless the peer hung up: its FIN
+              raises no new edge, so the loop reads on until recv returns 0
+    server: Struct that hold file descriptors and connection pool
+    conn: Client to read
+    events: epoll events reported for the client
+*/
+static void TCP_server_read(tcp_server_t *server, tcp_conn_t *conn, uint32_t events) {
+    while (!conn->closing) {
+        ssize_t recvBytes = recv(conn->fd, server->recv_buff, TCP_SERVER_RECV_SIZE, 0);
+        if (recvBytes > 0) {
+            if (server->on_read != NULL && server->on_read(server, conn, server->recv_buff, recvBytes) < 0) {
+                TCP_server_conn_close(server, conn);
+            }
+            if (recvBytes < TCP_SERVER_RECV_SIZE && !(events & (EPOLLRDHUP | EPOLLHUP))) {          //  Short read means the socket is empty
+                return;
+            }
+        }
+        else if (recvBytes == 0 || (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK)) {   //  Peer closed or reset
+            TCP_server_conn_close(server, conn);
+        }
+        else if (errno != EINTR) {
+            return;
+        }
+    }
+}
+
+/*
+    Function: Send as much of the queued bytes as the socket takes
+    conn: Client to flush
+    Return: 1 when the queue is empty, 0 when the socket is full, -1 on error
+*/
+static int32_t TCP_server_flush(tcp_conn_t *conn) {
+    while (conn->send_head < conn->send_len) {
+        ssize_t sentBytes = send(conn->fd, conn->send_buff + conn->send_head, conn->send_len - conn->send_head, MSG_NOSIGNAL);
+        if (sentBytes < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        }
+        conn->send_head += sentBytes;
+    }
+    conn->send_head = 0;
+    conn->send_len = 0;
+    return 1;
+}
+
+/*
+    Function: Send to a client without blocking. Whatever the socket does not take is queued and
+              sent when it becomes writable, on_write is called once the queue drains
+    server: Struct that hold file descriptors and connection pool
+    conn: Client to send to
+    send_msg: Send Message Buffer
+    send_len: Send Message Buffer Length
+*/
+int32_t TCP_server_conn_send(tcp_server_t *server, tcp_conn_t *conn, const uint8_t *send_msg, uint32_t send_len) {
+    if (conn->fd < 0 || conn->closing) {
+        return -1;
+    }
+    uint32_t sent = 0;
+    if (conn->send_len == 0) {                                                                      //  Nothing queued, try the socket first
+        while (sent < send_len) {
+            ssize_t sentBytes = send(conn->fd, send_msg + sent, send_len - sent, MSG_NOSIGNAL);
+            if (sentBytes < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    break;
+                }
+                snprintf(errorArray, sizeof(errorArray), "%s: Error Sending", __FUNCTION__);        //  Populate Error Array
+                perror(errorArray);                                                                 //  Print out this if it failed
+                TCP_server_conn_close(server, conn);
+                return -1;                                                                          //  Return error
+            }
+            sent += sentBytes;
+        }
+        if (sent == send_len) {
+            return 1;                                                                               //  Return good
+        }
+    }
+
+    uint32_t remaining = send_len - sent;
+    if (conn->send_len + remaining > TCP_SERVER_SEND_LIMIT) {                                       //  Client is not reading, drop it
+        snprintf(errorArray, sizeof(errorArray), "%s: Send Queue Full\n", __FUNCTION__);            //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        TCP_server_conn_close(server, conn);
+        return -1;                                                                                  //  Return error
+    }
+    if (conn->send_head > 0 && conn->send_len + remaining > conn->send_cap) {                       //  Reuse the sent front before growing
+        memmove(conn->send_buff, conn->send_buff + conn->send_head, conn->send_len - conn->send_head);
+        conn->send_len -= conn->send_head;
+        conn->send_head = 0;
+    }
+    if (conn->send_len + remaining > conn->send_cap) {
+        uint32_t cap = conn->send_cap ? conn->send_cap : 4096;
+        while (cap < conn->send_len + remaining) {
+            cap *= 2;
+        }
+        uint8_t *send_buff = realloc(conn->send_buff, cap);
+        if (send_buff == NULL) {
+            snprintf(errorArray, sizeof(errorArray), "%s: Allocate Send Queue\n", __FUNCTION__);    //  Populate Error Array
+            perror(errorArray);                                                                     //  Print out this if it failed
+            TCP_server_conn_close(server, conn);
+            return -1;                                                                              //  Return error
+        }
+        conn->send_buff = send_buff;
+        conn->send_cap = cap;
+    }
+    memcpy(conn->send_buff + conn->send_len, send_msg + sent, remaining);
+    conn->send_len += remaining;
+    return 1;                                                                                       //  Return good
+}
+
+/*
+    Function: Wait for events once and run the callbacks for them
+    server: Struct that hold file descriptors and connection pool
+    timeout_ms: Most time to wait, -1 waits forever
+    Return: Number of events handled, -1 on error
+*/
+int32_t TCP_server_poll(tcp_server_t *server, int32_t timeout_ms) {
+    int32_t ready = epoll_wait(server->epoll_fd, server->events, TCP_SERVER_MAX_EVENTS, timeout_ms);
+    if (ready < 0) {
+        if (errno == EINTR) {
+            return 0;
+        }
+        snprintf(errorArray, sizeof(errorArray), "%s: Epoll Wait Failed\n", __FUNCTION__);          //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        return -1;                                                                                  //  Return error
+    }
+    for (int32_t i = 0; i < ready; i++) {
+        struct epoll_event *event = &server->events[i];
+        if (event->data.ptr == NULL) {
+            TCP_server_accept(server);
+            continue;
+        }
+        if (event->data.ptr == server) {                                                            //  Woken by TCP_server_stop
+            uint64_t count;
+            read(server->wake_fd, &count, sizeof(count));
+            continue;
+        }
+        tcp_conn_t *conn = event->data.ptr;
+        if (conn->closing) {                                                                        //  Closed earlier in this batch
+            continue;
+        }
+        if (event->events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {                         //  Read first so a closing peer's last bytes arrive
+            TCP_server_read(server, conn, event->events);
+        }
+        if ((event->events & EPOLLOUT) && !conn->closing && conn->send_len > 0) {
+            int32_t flushed = TCP_server_flush(conn);
+            if (flushed < 0) {
+                TCP_server_conn_close(server, conn);
+            }
+            else if (flushed > 0 && server->on_write != NULL) {
+                server->on_write(server, conn);
+            }
+        }
+    }
+    TCP_server_reap(server);
+    return ready;
+}
+
+/*
+    Function: Run TCP_server_poll until TCP_server_stop is called
+    server: Struct that hold file descriptors and connection pool
+*/
+int32_t TCP_server_run(tcp_server_t *server) {
+    while (atomic_load_explicit(&server->running, memory_order_acquire)) {
+        if (TCP_server_poll(server, TCP_SERVER_RUN_TIMEOUT_MS) < 0) {
+            return -1;                                                                              //  Return error
+        }
+    }
+    return 1;                                                                                       //  Return good
+}
+
+/*
+    Function: Make TCP_server_run return, safe to call from any thread or a signal handler
+    server: Struct that hold file descriptors and connection pool
+*/
+void TCP_server_stop(tcp_server_t *server) {
+    atomic_store_explicit(&server->running, 0, memory_order_release);
+    uint64_t one = 1;
+    write(server->wake_fd, &one, sizeof(one));
+}
+
+/*
+    Function: Close every client and the server, then free the pool
+    server: Struct that hold file descriptors and connection pool
+*/
+void TCP_server_close(tcp_server_t *server) {
+    if (server->conns != NULL && server->close_list != NULL) {
+        for (uint32_t i = 0; i < server->max_conns; i++) {
+            TCP_server_conn_close(server, &server->conns[i]);
+        }
+        TCP_server_reap(server);
+    }
+    if (server->epoll_fd >= 0) {
+        close(server->epoll_fd);
+    }
+    if (server->wake_fd >= 0) {
+        close(server->wake_fd);
+    }
+    if (server->socket_fd >= 0) {
+        close(server->socket_fd);
+    }
+    free(server->conns);
+    free(server->free_list);
+    free(server->close_list);
+    free(server->events);
+    free(server->recv_buff);
+    server->conns = NULL;
+    server->free_list = NULL;
+    server->close_list = NULL;
+    server->events = NULL;
+    server->recv_buff = NULL;
+    server->epoll_fd = -1;
+    server->wake_fd = -1;
+    server->socket_fd = -1;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#ifndef TCP_SERVER_H
+#define TCP_SERVER_H
+
+//  Standard Libraries
+#include <errno.h>
+#include <stdatomic.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+
+//  Developed Libraries
+#include "TCP_common.h"
+
+//  TCP Server Misc.
+#define TCP_SERVER_MAX_EVENTS               (256)           //  Events handled per epoll_wait
+#define TCP_SERVER_RECV_SIZE                (64 * 1024)     //  Shared read buffer, one chunk per recv
+#define TCP_SERVER_SEND_LIMIT               (4 * 1024 * 1024)   //  Most bytes queued for one slow client
+#define TCP_SERVER_RUN_TIMEOUT_MS           (1000)          //  epoll_wait timeout inside TCP_server_run
+
+struct _tcp_server_t;
+struct _tcp_conn_t;
+
+//  Callbacks, all called from the thread running TCP_server_poll
+//  accept: New client, return < 0 to refuse it
+//  read: Bytes received from a client, return < 0 to close it
+//  write: Everything queued for a client has been sent
+//  close: Client is about to be closed, its fd is still open
+typedef int32_t (*tcp_accept_cb_t)(struct _tcp_server_t *server, struct _tcp_conn_t *conn);
+typedef int32_t (*tcp_read_cb_t)(struct _tcp_server_t *server, struct _tcp_conn_t *conn, const uint8_t *data, uint32_t len);
+typedef void (*tcp_write_cb_t)(struct _tcp_server_t *server, struct _tcp_conn_t *conn);
+typedef void (*tcp_close_cb_t)(struct _tcp_server_t *server, struct _tcp_conn_t *conn);
+
+#pragma pack(push, 8)
+//  TCP Connection Struct, one per client. user is free for the caller's own state
+typedef struct _tcp_conn_t {
+    int32_t fd;
+    uint32_t index;                                                                                 //  Slot in the server pool
+    uint8_t closing;
+    struct sockaddr_in addr_info;
+    uint8_t *send_buff;                                                                             //  Bytes the socket did not take yet
+    uint32_t send_head;
+    uint32_t send_len;
+    uint32_t send_cap;
+    void *user;
+} tcp_conn_t, *p_tcp_conn_t;
+
+//  TCP Server Struct
+//  Edge triggered epoll over a fixed pool of connections, so accept, read and close never search
+//  or allocate per event and the cost of one event does not grow with the client count
+typedef struct _tcp_server_t {
+    int32_t socket_fd;
+    int32_t epoll_fd;
+    int32_t wake_fd;                                                                                //  eventfd used by TCP_server_stop
+    _Atomic uint8_t running;
+    uint32_t max_conns;
+    uint32_t conn_count;
+    tcp_conn_t *conns;
+    uint32_t *free_list;                                                                            //  Stack of unused pool slots
+    uint32_t free_count;
+    tcp_conn_t **close_list;                                                                        //  Closed after the current batch of events
+    uint32_t close_count;
+    struct epoll_event *events;
+    uint8_t *recv_buff;
+    struct sockaddr_in addr_info;
+    tcp_accept_cb_t on_accept;
+    tcp_read_cb_t on_read;
+    tcp_write_cb_t on_write;
+    tcp_close_cb_t on_close;
+    void *user;
+} tcp_server_t, *p_tcp_server_t;
+#pragma pack(pop)
+
+//  Declare Functions
+int32_t TCP_server_init(tcp_server_t *server, const uint8_t *ip, uint16_t port, uint32_t max_conns);
+void TCP_server_set_callbacks(tcp_server_t *server, tcp_accept_cb_t on_accept, tcp_read_cb_t on_read, tcp_write_cb_t on_write, tcp_close_cb_t on_close, void *user);
+int32_t TCP_server_poll(tcp_server_t *server, int32_t timeout_ms);
+int32_t TCP_server_run(tcp_server_t *server);
+void TCP_server_stop(tcp_server_t *server);
+int32_t TCP_server_conn_send(tcp_server_t *server, tcp_conn_t *conn, const uint8_t *send_msg, uint32_t send_len);
+void TCP_server_conn_close(tcp_server_t *server, tcp_conn_t *conn);
+void TCP_server_close(tcp_server_t *server);
+
+#endif
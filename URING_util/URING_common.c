@@ -0,0 +1,839 @@
+#define _GNU_SOURCE
+
+//  Developed Libraries
+#include "URING_common.h"
+
+#define URING_TAG_RECV                      (0ULL)          //  user_data low bits, connection receive
+#define URING_TAG_SEND                      (1ULL)          //  user_data low bits, queued send
+#define URING_TAG_CANCEL                    (2ULL)          //  user_data low bits, cancel request
+#define URING_TAG_MASK                      (3ULL)
+#define URING_MAX_BUFF_COUNT                (32768)         //  Kernel limit on provided buffer ring entries
+#define URING_CLOSE_POLLS                   (50)            //  URING_close waits this many 10 ms polls for cancels
+
+static uint8_t errorArray[120] = {0};                                                               //  Error array to help print specific function
+
+/*
+    Function: io_uring system calls, called directly so no liburing is needed
+*/
+static int32_t URING_sys_setup(uint32_t entries, struct io_uring_params *params) {
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int32_t URING_sys_enter(int32_t ring_fd, uint32_t to_submit, uint32_t min_complete, uint32_t flags, void *arg, size_t arg_size) {
+    return syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, arg, arg_size);
+}
+
+static int32_t URING_sys_register(int32_t ring_fd, uint32_t opcode, void *arg, uint32_t nr_args) {
+    return syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args);
+}
+
+/*
+    Function: Give one receive buffer back to the kernel, seen after URING_buff_publish
+    uring: Struct that hold the rings and connections
+    bid: Buffer id
+*/
+static void URING_buff_add(uring_info_t *uring, uint16_t bid) {
+    struct io_uring_buf *buf = &uring->buf_ring->bufs[uring->buf_tail & (uring->buff_count - 1)];
+    buf->addr = (uint64_t) (uintptr_t) (uring->buffs + (size_t) bid * uring->buff_size);
+    buf->len = uring->buff_size;
+    buf->bid = bid;
+    uring->buf_tail++;
+}
+
+/*
+    Function: Publish the buffers added since the last call
+    uring: Struct that hold the rings and connections
+*/
+static void URING_buff_publish(uring_info_t *uring) {
+    atomic_store_explicit((_Atomic uint16_t *) &uring->buf_ring->tail, uring->buf_tail, memory_order_release);
+}
+
+/*
+    Function: Unmap the rings and free the connection pool
+    uring: Struct that hold the rings and connections
+*/
+static void URING_free(uring_info_t *uring) {
+    if (uring->sqes != NULL && uring->sqes != MAP_FAILED) {
+        munmap(uring->sqes, uring->sqes_size);
+    }
+    if (uring->cq_ring != NULL && uring->cq_ring != MAP_FAILED && uring->cq_ring != uring->sq_ring) {
+        munmap(uring->cq_ring, uring->cq_ring_size);
+    }
+    if (uring->sq_ring != NULL && uring->sq_ring != MAP_FAILED) {
+        munmap(uring->sq_ring, uring->sq_ring_size);
+    }
+    if (uring->buf_ring != NULL && uring->buf_ring != MAP_FAILED) {
+        munmap(uring->buf_ring, uring->buf_ring_size);
+    }
+    if (uring->ring_fd >= 0) {
+        close(uring->ring_fd);
+    }
+    uring->sqes = NULL;
+    uring->cq_ring = NULL;
+    uring->sq_ring = NULL;
+    uring->buf_ring = NULL;
+    uring->ring_fd = -1;
+    free(uring->buffs);
+    uring->buffs = NULL;
+}
+
+/*
+    Function: Set up the rings and the provided buffer ring
+    uring: Struct that hold the rings and connections
+    entries: Submission queue size
+    Return: 1 on success, -1 if io_uring or a needed feature is missing
+*/
+static int32_t URING_ring_init(uring_info_t *uring, uint32_t entries) {
+    struct io_uring_params params = {0};
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL;                                   //  Multishot receives need a deep CQ
+    params.cq_entries = entries * 4;
+    if ((uring->ring_fd = URING_sys_setup(entries, &params)) < 0) {                                 //  ENOSYS, EPERM or io_uring_disabled
+        return -1;
+    }
+    if (!(params.features & IORING_FEAT_NODROP) || !(params.features & IORING_FEAT_EXT_ARG)) {      //  Older than the buffer ring anyway
+        return -1;
+    }
+    uring->features = params.features;
+
+    uring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    uring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {                                                //  Both rings in one mapping
+        uring->sq_ring_size = uring->cq_ring_size = (uring->sq_ring_size > uring->cq_ring_size) ? uring->sq_ring_size : uring->cq_ring_size;
+    }
+    uring->sq_ring = mmap(NULL, uring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring->ring_fd, IORING_OFF_SQ_RING);
+    if (uring->sq_ring == MAP_FAILED) {
+        return -1;
+    }
+    uring->cq_ring = (params.features & IORING_FEAT_SINGLE_MMAP) ? uring->sq_ring : mmap(NULL, uring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring->ring_fd, IORING_OFF_CQ_RING);
+    if (uring->cq_ring == MAP_FAILED) {
+        return -1;
+    }
+    uring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    uring->sqes = mmap(NULL, uring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring->ring_fd, IORING_OFF_SQES);
+    if (uring->sqes == MAP_FAILED) {
+        return -1;
+    }
+    uring->sq_head = (_Atomic uint32_t *) (uring->sq_ring + params.sq_off.head);
+    uring->sq_tail = (_Atomic uint32_t *) (uring->sq_ring + params.sq_off.tail);
+    uring->sq_array = (uint32_t *) (uring->sq_ring + params.sq_off.array);
+    uring->sq_mask = *(uint32_t *) (uring->sq_ring + params.sq_off.ring_mask);
+    uring->sq_entries = params.sq_entries;
+    uring->sqe_tail = uring->sqe_submitted = atomic_load_explicit(uring->sq_tail, memory_order_relaxed);
+    uring->cq_head = (_Atomic uint32_t *) (uring->cq_ring + params.cq_off.head);
+    uring->cq_tail = (_Atomic uint32_t *) (uring->cq_ring + params.cq_off.tail);
+    uring->cq_mask = *(uint32_t *) (uring->cq_ring + params.cq_off.ring_mask);
+    uring->cqes = (struct io_uring_cqe *) (uring->cq_ring + params.cq_off.cqes);
+
+    uring->buf_ring_size = uring->buff_count * sizeof(struct io_uring_buf);                         //  Page aligned by mmap as the kernel wants
+    uring->buf_ring = mmap(NULL, uring->buf_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (uring->buf_ring == MAP_FAILED) {
+        return -1;
+    }
+    struct io_uring_buf_reg reg = {0};
+    reg.ring_addr = (uint64_t) (uintptr_t) uring->buf_ring;
+    reg.ring_entries = uring->buff_count;
+    reg.bgid = URING_BUFF_GROUP;
+    if (URING_sys_register(uring->ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {               //  Needs 5.19
+        return -1;
+    }
+    if ((uring->buffs = malloc((size_t) uring->buff_count * uring->buff_size)) == NULL) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < uring->buff_count; i++) {
+        URING_buff_add(uring, i);
+    }
+    URING_buff_publish(uring);
+    return 1;
+}
+
+/*
+    Function: Initialize the io_uring engine. Falls back to poll, recv and send when io_uring, the
+              provided buffer ring or extended enter arguments are missing
+    uring: Struct that hold the rings and connections
+    entries: Submission queue size (0 uses URING_DEFAULT_ENTRIES)
+    max_conns: Most sockets registered at once
+    buff_count: Provided receive buffers (0 uses URING_DEFAULT_BUFF_COUNT)
+    buff_size: Bytes per receive buffer, the largest message one receive returns (0 uses URING_DEFAULT_BUFF_SIZE)
+    Return: 1 using io_uring, 0 using the fallback, -1 on error
+*/
+int32_t URING_init(uring_info_t *uring, uint32_t entries, uint32_t max_conns, uint32_t buff_count, uint32_t buff_size) {
+    memset(uring, 0, sizeof(uring_info_t));
+    uring->ring_fd = -1;
+    uring->multishot = 1;
+    entries = entries ? entries : URING_DEFAULT_ENTRIES;
+    buff_count = buff_count ? buff_count : URING_DEFAULT_BUFF_COUNT;
+    uring->buff_size = buff_size ? buff_size : URING_DEFAULT_BUFF_SIZE;
+    uring->buff_count = 1;
+    while (uring->buff_count < buff_count && uring->buff_count < URING_MAX_BUFF_COUNT) {            //  Ring size must be a power of two
+        uring->buff_count <<= 1;
+    }
+
+    uring->max_conns = max_conns;
+    uring->conns = calloc(max_conns, sizeof(uring_conn_t));
+    uring->free_list = malloc(max_conns * sizeof(uint32_t));
+    if (max_conns == 0 || uring->conns == NULL || uring->free_list == NULL) {
+        snprintf(errorArray, sizeof(errorArray), "%s: Allocate Connection Pool\n", __FUNCTION__);   //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        URING_close(uring);
+        return -1;                                                                                  //  Return error
+    }
+    for (uint32_t i = 0; i < max_conns; i++) {
+        uring->conns[i].fd = -1;
+        uring->conns[i].index = i;
+        uring->free_list[i] = max_conns - 1 - i;
+    }
+    uring->free_count = max_conns;
+
+    if (URING_ring_init(uring, entries) > 0) {
+        return 1;                                                                                   //  Return good
+    }
+    URING_free(uring);                                                                              //  Fall back to the plain socket calls
+    uring->fallback = 1;
+    uring->buffs = malloc(uring->buff_size);
+    uring->poll_fds = malloc(max_conns * sizeof(struct pollfd));
+    uring->poll_map = malloc(max_conns * sizeof(uint32_t));
+    if (uring->buffs == NULL || uring->poll_fds == NULL || uring->poll_map == NULL) {
+        snprintf(errorArray, sizeof(errorArray), "%s: Allocate Fallback Buffers\n", __FUNCTION__);  //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        URING_close(uring);
+        return -1;                                                                                  //  Return error
+    }
+    return 0;                                                                                       //  Return fallback
+}
+
+/*
+    Function: Publish the queued SQEs and enter the kernel once
+    uring: Struct that hold the rings and connections
+    wait: Completions to wait for
+    timeout_ms: Most time to wait, -1 waits forever
+    Return: 0 or higher on success, -1 on error
+*/
+static int32_t URING_enter(uring_info_t *uring, uint32_t wait, int32_t timeout_ms) {
+    atomic_store_explicit(uring->sq_tail, uring->sqe_tail, memory_order_release);
+    uint32_t to_submit = uring->sqe_tail - uring->sqe_submitted;
+    uint32_t flags = wait ? IORING_ENTER_GETEVENTS : 0;
+    struct __kernel_timespec ts = {0};
+    struct io_uring_getevents_arg arg = {0};
+    if (wait && timeout_ms >= 0) {
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (long long) (timeout_ms % 1000) * 1000000;
+        arg.ts = (uint64_t) (uintptr_t) &ts;
+        flags |= IORING_ENTER_EXT_ARG;
+    }
+    if (to_submit == 0 && wait == 0) {
+        return 0;
+    }
+    int32_t status = URING_sys_enter(uring->ring_fd, to_submit, wait, flags, (flags & IORING_ENTER_EXT_ARG) ? &arg : NULL, (flags & IORING_ENTER_EXT_ARG) ? sizeof(arg) : 0);
+    uring->sqe_submitted = atomic_load_explicit(uring->sq_head, memory_order_acquire);              //  Whatever the kernel consumed
+    if (status < 0 && errno != ETIME && errno != EINTR && errno != EBUSY) {                         //  EBUSY, CQ backlog, drained by the caller
+        snprintf(errorArray, sizeof(errorArray), "%s: io_uring_enter Failed\n", __FUNCTION__);      //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        return -1;                                                                                  //  Return error
+    }
+    return (status < 0) ? 0 : status;
+}
+
+/*
+    Function: Get the next free SQE, submitting the queued ones first if the ring is full
+    uring: Struct that hold the rings and connections
+    Return: Cleared SQE or NULL
+*/
+static struct io_uring_sqe *URING_get_sqe(uring_info_t *uring) {
+    if (uring->sqe_tail - atomic_load_explicit(uring->sq_head, memory_order_acquire) >= uring->sq_entries) {
+        URING_enter(uring, 0, 0);
+        if (uring->sqe_tail - atomic_load_explicit(uring->sq_head, memory_order_acquire) >= uring->sq_entries) {
+            snprintf(errorArray, sizeof(errorArray), "%s: Submission Queue Full\n", __FUNCTION__);  //  Populate Error Array
+            perror(errorArray);                                                                     //  Print out this if it failed
+            return NULL;
+        }
+    }
+    uint32_t index = uring->sqe_tail & uring->sq_mask;
+    struct io_uring_sqe *sqe = &uring->sqes[index];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    uring->sq_array[index] = index;
+    uring->sqe_tail++;
+    return sqe;
+}
+
+/*
+    Function: Queue a receive on a connection, multishot when the kernel has it
+    uring: Struct that hold the rings and connections
+    conn: Connection to receive on
+*/
+static int32_t URING_arm_recv(uring_info_t *uring, uring_conn_t *conn) {
+    struct io_uring_sqe *sqe = URING_get_sqe(uring);
+    if (sqe == NULL) {
+        return -1;
+    }
+    sqe->fd = conn->fd;
+    sqe->flags = IOSQE_BUFFER_SELECT;                                                               //  Kernel picks a buffer when data arrives
+    sqe->buf_group = URING_BUFF_GROUP;
+    sqe->ioprio = uring->multishot ? IORING_RECV_MULTISHOT : 0;
+    sqe->user_data = (uint64_t) (uintptr_t) conn | URING_TAG_RECV;
+    if (conn->stream) {
+        sqe->opcode = IORING_OP_RECV;
+    }
+    else {                                                                                          //  recvmsg to learn the sender
+        memset(&conn->recv_msg, 0, sizeof(conn->recv_msg));
+        conn->recv_msg.msg_name = &conn->recv_addr;
+        conn->recv_msg.msg_namelen = sizeof(conn->recv_addr);
+        sqe->opcode = IORING_OP_RECVMSG;
+        sqe->addr = (uint64_t) (uintptr_t) &conn->recv_msg;
+        sqe->len = 1;
+    }
+    conn->recv_armed = 1;
+    return 1;
+}
+
+/*
+    Function: Register a socket and start receiving on it
+    uring: Struct that hold the rings and connections
+    fd: Socket to register
+    stream: 1 for TCP, 0 for UDP
+    dest: UDP destination, NULL for TCP
+    on_recv: Receive callback
+    user: Caller data kept in conn->user
+*/
+static uring_conn_t *URING_add(uring_info_t *uring, int32_t fd, uint8_t stream, const struct sockaddr_in *dest, uring_recv_cb_t on_recv, void *user) {
+    if (uring->free_count == 0) {
+        snprintf(errorArray, sizeof(errorArray), "%s: Connection Pool Full\n", __FUNCTION__);       //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        return NULL;
+    }
+    uring_conn_t *conn = &uring->conns[uring->free_list[--uring->free_count]];
+    conn->fd = fd;
+    conn->stream = stream;
+    conn->on_recv = on_recv;
+    conn->user = user;
+    if (dest != NULL) {
+        memcpy(&conn->addr_info, dest, sizeof(struct sockaddr_in));
+    }
+    if (uring->fallback) {
+        conn->recv_armed = 1;                                                                       //  Polled by URING_poll
+    }
+    else if (URING_arm_recv(uring, conn) < 0) {
+        conn->fd = -1;
+        uring->free_list[uring->free_count++] = conn->index;
+        return NULL;
+    }
+    return conn;
+}
+
+/*
+    Function: Register a connected TCP socket, tcp_info->socket_fd for a client or
+              tcp_info->client_fd for a server, in place of the TCP_*_recv_* calls
+    uring: Struct that hold the rings and connections
+    fd: Connected TCP socket
+    on_recv: Receive callback
+    user: Caller data kept in conn->user
+*/
+uring_conn_t *URING_add_tcp(uring_info_t *uring, int32_t fd, uring_recv_cb_t on_recv, void *user) {
+    return URING_add(uring, fd, 1, NULL, on_recv, user);
+}
+
+/*
+    Function: Register a UDP socket from any UDP_*_init in place of the UDP_*_recv_* calls.
+              Sends go to udp_info->addr_info, then to the last sender like UDP_server_send
+    uring: Struct that hold the rings and connections
+    udp_info: Initialized UDP struct
+    on_recv: Receive callback
+    user: Caller data kept in conn->user
+*/
+uring_conn_t *URING_add_udp(uring_info_t *uring, udp_info_t *udp_info, uring_recv_cb_t on_recv, void *user) {
+    return URING_add(uring, udp_info->socket_fd, 0, &udp_info->addr_info, on_recv, user);
+}
+
+/*
+    Function: Return a send slot to the free list
+    uring: Struct that hold the rings and connections
+    send: Send slot
+*/
+static void URING_send_free(uring_info_t *uring, uring_send_t *send) {
+    send->next = uring->free_sends;
+    uring->free_sends = send;
+}
+
+/*
+    Function: Free a connection slot once nothing is in flight on it
+    uring: Struct that hold the rings and connections
+    conn: Connection being removed
+*/
+static void URING_release(uring_info_t *uring, uring_conn_t *conn) {
+    if (!conn->closing || conn->recv_armed || conn->sends_inflight) {
+        return;
+    }
+    while (conn->send_head != NULL) {
+        uring_send_t *send = conn->send_head;
+        conn->send_head = send->next;
+        URING_send_free(uring, send);
+    }
+    if (conn->needs_issue) {
+        uring->stalled--;
+    }
+    uint32_t index = conn->index;
+    memset(conn, 0, sizeof(uring_conn_t));
+    conn->fd = -1;
+    conn->index = index;
+    uring->free_list[uring->free_count++] = index;
+}
+
+/*
+    Function: Stop receiving and sending on a connection. The slot is reused once the kernel has
+              finished with it, close the socket yourself after this call
+    uring: Struct that hold the rings and connections
+    conn: Connection to remove
+*/
+void URING_remove(uring_info_t *uring, uring_conn_t *conn) {
+    if (conn->fd < 0 || conn->closing) {
+        return;
+    }
+    conn->closing = 1;
+    if (conn->stream && conn->send_head != NULL) {                                                  //  Drop TCP sends that never went out
+        uring_send_t *keep = conn->sends_inflight ? conn->send_head : NULL;
+        uring_send_t *send = keep ? keep->next : conn->send_head;
+        while (send != NULL) {
+            uring_send_t *next = send->next;
+            URING_send_free(uring, send);
+            send = next;
+        }
+        conn->send_head = conn->send_tail = keep;
+        if (keep != NULL) {
+            keep->next = NULL;
+        }
+    }
+    if (uring->fallback) {
+        conn->recv_armed = 0;
+    }
+    else if (conn->recv_armed || conn->sends_inflight) {                                            //  Cancel everything on the socket
+        struct io_uring_sqe *sqe = URING_get_sqe(uring);
+        if (sqe == NULL) {                                                                          //  No room for the cancel, shutting the socket down ends its requests too
+            shutdown(conn->fd, SHUT_RDWR);
+        }
+        else {
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->fd = conn->fd;
+            sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+            sqe->user_data = URING_TAG_CANCEL;
+            URING_enter(uring, 0, 0);                                                               //  Cancel now, the caller closes the socket next
+        }
+    }
+    URING_release(uring, conn);
+}
+
+/*
+    Function: Queue the SQE for a send slot
+    uring: Struct that hold the rings and connections
+    send: Send slot
+*/
+static int32_t URING_send_issue(uring_info_t *uring, uring_send_t *send) {
+    struct io_uring_sqe *sqe = URING_get_sqe(uring);
+    if (sqe == NULL) {
+        return -1;
+    }
+    uring_conn_t *conn = send->conn;
+    sqe->fd = conn->fd;
+    sqe->user_data = (uint64_t) (uintptr_t) send | URING_TAG_SEND;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    if (conn->stream) {
+        sqe->opcode = IORING_OP_SEND;
+        sqe->addr = (uint64_t) (uintptr_t) (send->data + send->done);
+        sqe->len = send->len - send->done;
+    }
+    else {
+        send->iov.iov_base = send->data;
+        send->iov.iov_len = send->len;
+        memset(&send->msg, 0, sizeof(send->msg));
+        send->msg.msg_name = &send->addr_info;
+        send->msg.msg_namelen = sizeof(send->addr_info);
+        send->msg.msg_iov = &send->iov;
+        send->msg.msg_iovlen = 1;
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->addr = (uint64_t) (uintptr_t) &send->msg;
+        sqe->len = 1;
+    }
+    conn->sends_inflight++;
+    if (conn->needs_issue) {                                                                        //  A stalled head is moving again
+        conn->needs_issue = 0;
+        uring->stalled--;
+    }
+    return 1;
+}
+
+/*
+    Function: Issue the head send of a TCP connection, or mark the connection stalled when there
+              is no free SQE so URING_submit and URING_poll retry it. Nothing else would, no
+              completion is coming while nothing is in flight
+    uring: Struct that hold the rings and connections
+    conn: Connection whose head send is due
+*/
+static void URING_send_head(uring_info_t *uring, uring_conn_t *conn) {
+    if (URING_send_issue(uring, conn->send_head) < 0 && !conn->needs_issue) {
+        conn->needs_issue = 1;
+        uring->stalled++;
+    }
+}
+
+/*
+    Function: Retry the head sends that stalled on a full submission queue
+    uring: Struct that hold the rings and connections
+*/
+static void URING_send_retry(uring_info_t *uring) {
+    for (uint32_t i = 0; i < uring->max_conns && uring->stalled > 0; i++) {
+        uring_conn_t *conn = &uring->conns[i];
+        if (!conn->needs_issue) {
+            continue;
+        }
+        if (conn->closing || conn->send_head == NULL || conn->sends_inflight > 0) {                 //  Nothing left to issue
+            conn->needs_issue = 0;
+            uring->stalled--;
+            continue;
+        }
+        if (URING_send_issue(uring, conn->send_head) < 0) {                                         //  Still full, try again next time
+            break;
+        }
+    }
+}
+
+/*
+    Function: Submit every queued send and receive in one system call, first retrying the TCP
+              sends that stalled on a full submission queue
+    uring: Struct that hold the rings and connections
+    Return: SQEs submitted, -1 on error
+*/
+int32_t URING_submit(uring_info_t *uring) {
+    if (uring->fallback) {
+        return 0;                                                                                   //  Fallback sends are already done
+    }
+    URING_send_retry(uring);
+    return URING_enter(uring, 0, 0);
+}
+
+/*
+    Function: Send on a connection with the plain socket calls, the fallback path
+    conn: Connection to send on
+    send_msg: Send Message Buffer
+    send_len: Send Message Buffer Length
+*/
+static int32_t URING_send_fallback(uring_conn_t *conn, const uint8_t *send_msg, uint32_t send_len) {
+    if (!conn->stream) {
+        if (sendto(conn->fd, send_msg, send_len, 0, (const struct sockaddr *) &conn->addr_info, sizeof(conn->addr_info)) < 0) {
+            snprintf(errorArray, sizeof(errorArray), "%s: Error Sending\n", __FUNCTION__);          //  Populate Error Array
+            perror(errorArray);                                                                     //  Print out this if it failed
+            return -1;                                                                              //  Return error
+        }
+        return 1;                                                                                   //  Return good
+    }
+    uint32_t sent = 0;
+    while (sent < send_len) {
+        ssize_t sentBytes = send(conn->fd, send_msg + sent, send_len - sent, MSG_NOSIGNAL);
+        if (sentBytes < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {                                          //  Caller made the socket non blocking, wait for room
+                struct pollfd pfd = { .fd = conn->fd, .events = POLLOUT };
+                poll(&pfd, 1, -1);
+                continue;
+            }
+            snprintf(errorArray, sizeof(errorArray), "%s: Error Sending\n", __FUNCTION__);          //  Populate Error Array
+            perror(errorArray);                                                                     //  Print out this if it failed
+            return -1;                                                                              //  Return error
+        }
+        sent += sentBytes;
+    }
+    return 1;                                                                                       //  Return good
+}
+
+/*
+    Function: Queue a send. The message is copied, so the buffer is free on return. Queued sends
+              go to the kernel together on the next URING_submit or URING_poll. TCP sends on one
+              socket go out in order, one in flight at a time, short sends are finished for you
+    uring: Struct that hold the rings and connections
+    conn: Connection to send on
+    send_msg: Send Message Buffer
+    send_len: Send Message Buffer Length
+*/
+int32_t URING_send(uring_info_t *uring, uring_conn_t *conn, const uint8_t *send_msg, uint32_t send_len) {
+    if (conn->fd < 0 || conn->closing) {
+        return -1;
+    }
+    if (uring->fallback) {
+        return URING_send_fallback(conn, send_msg, send_len);
+    }
+    uring_send_t *send = uring->free_sends;
+    if (send != NULL) {
+        uring->free_sends = send->next;
+    }
+    else if ((send = calloc(1, sizeof(uring_send_t))) == NULL) {
+        snprintf(errorArray, sizeof(errorArray), "%s: Allocate Send Slot\n", __FUNCTION__);         //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        return -1;                                                                                  //  Return error
+    }
+    if (send->cap < send_len) {                                                                     //  Slots keep their buffer when reused
+        uint8_t *data = realloc(send->data, send_len);
+        if (data == NULL) {
+            snprintf(errorArray, sizeof(errorArray), "%s: Allocate Send Buffer\n", __FUNCTION__);   //  Populate Error Array
+            perror(errorArray);                                                                     //  Print out this if it failed
+            URING_send_free(uring, send);
+            return -1;                                                                              //  Return error
+        }
+        send->data = data;
+        send->cap = send_len;
+    }
+    memcpy(send->data, send_msg, send_len);
+    send->len = send_len;
+    send->done = 0;
+    send->conn = conn;
+    send->next = NULL;
+    if (!conn->stream) {
+        memcpy(&send->addr_info, &conn->addr_info, sizeof(send->addr_info));
+        if (URING_send_issue(uring, send) < 0) {
+            URING_send_free(uring, send);
+            return -1;                                                                              //  Return error
+        }
+        return 1;                                                                                   //  Return good
+    }
+    if (conn->send_tail != NULL) {
+        conn->send_tail->next = send;
+    }
+    else {
+        conn->send_head = send;
+    }
+    conn->send_tail = send;
+    if (conn->sends_inflight == 0) {                                                                //  Head may be an older send that could not be issued
+        URING_send_head(uring, conn);                                                               //  Queued either way, a stall is retried on submit
+    }
+    return 1;                                                                                       //  Return good
+}
+
+/*
+    Function: Handle a send completion, finishing short TCP sends and starting the next one
+    uring: Struct that hold the rings and connections
+    send: Send slot
+    res: Bytes sent or -errno
+*/
+static void URING_send_done(uring_info_t *uring, uring_send_t *send, int32_t res) {
+    uring_conn_t *conn = send->conn;
+    conn->sends_inflight--;
+    if (!conn->stream) {
+        URING_send_free(uring, send);
+    }
+    else {
+        if (res > 0 && send->done + res < send->len && !conn->closing) {                           //  Short send, finish it before the next
+            send->done += res;
+            URING_send_head(uring, conn);
+            return;
+        }
+        conn->send_head = send->next;
+        if (conn->send_head == NULL) {
+            conn->send_tail = NULL;
+        }
+        URING_send_free(uring, send);
+        if (res < 0 && res != -ECANCELED) {                                                         //  Stream is broken, drop what is queued
+            errno = -res;
+            snprintf(errorArray, sizeof(errorArray), "%s: Error Sending\n", __FUNCTION__);          //  Populate Error Array
+            perror(errorArray);                                                                     //  Print out this if it failed
+            while (conn->send_head != NULL) {
+                uring_send_t *next = conn->send_head->next;
+                URING_send_free(uring, conn->send_head);
+                conn->send_head = next;
+            }
+            conn->send_tail = NULL;
+        }
+        else if (conn->send_head != NULL && !conn->closing) {
+            URING_send_head(uring, conn);
+        }
+    }
+    URING_release(uring, conn);
+}
+
+/*
+    Function: Handle a receive completion and recycle its buffer
+    uring: Struct that hold the rings and connections
+    conn: Connection the data arrived on
+    cqe: Completion
+*/
+static void URING_recv_done(uring_info_t *uring, uring_conn_t *conn, const struct io_uring_cqe *cqe) {
+    int32_t res = cqe->res;
+    uint8_t *buff = NULL;
+    uint16_t bid = 0;
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {                                                        //  Multishot ended or single shot done
+        conn->recv_armed = 0;
+    }
+    if (cqe->flags & IORING_CQE_F_BUFFER) {
+        bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        buff = uring->buffs + (size_t) bid * uring->buff_size;
+    }
+    if (res > 0 && buff != NULL && !conn->closing && conn->on_recv != NULL) {
+        if (conn->stream) {
+            conn->on_recv(uring, conn, buff, res, NULL);
+        }
+        else if (uring->multishot) {                                                                //  Header, name, then payload in the buffer
+            struct io_uring_recvmsg_out *out = (struct io_uring_recvmsg_out *) buff;
+            size_t offset = sizeof(struct io_uring_recvmsg_out) + conn->recv_msg.msg_namelen + conn->recv_msg.msg_controllen;
+            if ((size_t) res >= offset) {
+                uint32_t len = ((size_t) res - offset < out->payloadlen) ? (uint32_t) (res - offset) : out->payloadlen;
+                size_t name_len = (out->namelen < sizeof(struct sockaddr_in)) ? out->namelen : sizeof(struct sockaddr_in);
+                memcpy(&conn->addr_info, buff + sizeof(struct io_uring_recvmsg_out), name_len);     //  Reply to the last sender
+                conn->on_recv(uring, conn, buff + offset, len, &conn->addr_info);
+            }
+        }
+        else {
+            memcpy(&conn->addr_info, &conn->recv_addr, sizeof(conn->addr_info));
+            conn->on_recv(uring, conn, buff, res, &conn->addr_info);
+        }
+    }
+    if (buff != NULL) {
+        URING_buff_add(uring, bid);
+    }
+    if (conn->recv_armed) {
+        return;
+    }
+    if (conn->closing) {
+        URING_release(uring, conn);
+        return;
+    }
+    if (res == -EINVAL && uring->multishot) {                                                       //  Kernel without multishot receive
+        uring->multishot = 0;
+        URING_arm_recv(uring, conn);
+        return;
+    }
+    if (res > 0 || res == -ENOBUFS || res == -EINTR) {                                              //  Out of buffers, they come back this poll
+        URING_arm_recv(uring, conn);
+        return;
+    }
+    if (conn->on_recv != NULL) {                                                                    //  Peer closed or error
+        conn->on_recv(uring, conn, NULL, res, NULL);
+    }
+}
+
+/*
+    Function: Wait on the registered sockets with poll and read them, the fallback path
+    uring: Struct that hold the rings and connections
+    timeout_ms: Most time to wait, -1 waits forever
+*/
+static int32_t URING_poll_fallback(uring_info_t *uring, int32_t timeout_ms) {
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < uring->max_conns; i++) {
+        if (uring->conns[i].fd >= 0 && uring->conns[i].recv_armed && !uring->conns[i].closing) {
+            uring->poll_fds[count].fd = uring->conns[i].fd;
+            uring->poll_fds[count].events = POLLIN;
+            uring->poll_fds[count].revents = 0;
+            uring->poll_map[count++] = i;
+        }
+    }
+    int32_t ready = poll(uring->poll_fds, count, timeout_ms);
+    if (ready < 0) {
+        if (errno == EINTR) {
+            return 0;
+        }
+        snprintf(errorArray, sizeof(errorArray), "%s: Poll Failed\n", __FUNCTION__);                //  Populate Error Array
+        perror(errorArray);                                                                         //  Print out this if it failed
+        return -1;                                                                                  //  Return error
+    }
+    int32_t handled = 0;
+    for (uint32_t i = 0; i < count && ready > 0; i++) {
+        if (uring->poll_fds[i].revents == 0) {
+            continue;
+        }
+        ready--;
+        uring_conn_t *conn = &uring->conns[uring->poll_map[i]];
+        if (conn->closing || !conn->recv_armed) {                                                   //  Removed by an earlier callback
+            continue;
+        }
+        struct sockaddr_in addr_info = {0};
+        socklen_t addr_len = sizeof(addr_info);
+        ssize_t recvBytes = recvfrom(conn->fd, uring->buffs, uring->buff_size, MSG_DONTWAIT, conn->stream ? NULL : (struct sockaddr *) &addr_info, conn->stream ? NULL : &addr_len);
+        if (recvBytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            continue;
+        }
+        handled++;
+        if (recvBytes <= 0) {
+            conn->recv_armed = 0;
+        }
+        else if (!conn->stream) {
+            memcpy(&conn->addr_info, &addr_info, sizeof(addr_info));                                //  Reply to the last sender
+        }
+        if (conn->on_recv != NULL) {
+            conn->on_recv(uring, conn, (recvBytes > 0) ? uring->buffs : NULL, (recvBytes < 0) ? -errno : recvBytes, conn->stream ? NULL : &conn->addr_info);
+        }
+    }
+    return handled;
+}
+
+/*
+    Function: Submit queued work, wait for completions and run the receive callbacks. One system
+              call covers every send queued since the last call and every completion ready
+    uring: Struct that hold the rings and connections
+    timeout_ms: Most time to wait when nothing is ready, -1 waits forever
+    Return: Completions handled, -1 on error
+*/
+int32_t URING_poll(uring_info_t *uring, int32_t timeout_ms) {
+    if (uring->fallback) {
+        return URING_poll_fallback(uring, timeout_ms);
+    }
+    URING_send_retry(uring);
+    uint32_t head = atomic_load_explicit(uring->cq_head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(uring->cq_tail, memory_order_acquire);
+    if (URING_enter(uring, (head == tail) ? 1 : 0, timeout_ms) < 0) {
+        return -1;                                                                                  //  Return error
+    }
+    tail = atomic_load_explicit(uring->cq_tail, memory_order_acquire);
+    int32_t handled = 0;
+    while (head != tail) {
+        struct io_uring_cqe cqe = uring->cqes[head & uring->cq_mask];
+        head++;
+        handled++;
+        switch (cqe.user_data & URING_TAG_MASK) {
+            case URING_TAG_RECV:
+                URING_recv_done(uring, (uring_conn_t *) (uintptr_t) cqe.user_data, &cqe);
+                break;
+            case URING_TAG_SEND:
+                URING_send_done(uring, (uring_send_t *) (uintptr_t) (cqe.user_data & ~URING_TAG_MASK), cqe.res);
+                break;
+            default:                                                                                //  Cancel results need nothing
+                break;
+        }
+    }
+    atomic_store_explicit(uring->cq_head, head, memory_order_release);
+    URING_buff_publish(uring);                                                                      //  Recycled buffers, before any re-arm goes in
+    return handled;
+}
+
+/*
+    Function: Remove every connection, wait briefly for the kernel to finish with them, then
+              free the rings and send slots. Registered sockets are left open
+    uring: Struct that hold the rings and connections
+*/
+void URING_close(uring_info_t *uring) {
+    if (uring->conns != NULL && uring->free_list != NULL) {
+        for (uint32_t i = 0; i < uring->max_conns; i++) {
+            URING_remove(uring, &uring->conns[i]);
+        }
+        for (uint32_t i = 0; i < URING_CLOSE_POLLS && !uring->fallback && uring->free_count < uring->max_conns; i++) {
+            URING_poll(uring, 10);
+        }
+    }
+    URING_free(uring);                                                                              //  Closing the ring drops anything still pending
+    for (uint32_t i = 0; uring->conns != NULL && i < uring->max_conns; i++) {                       //  Sends still parked on a connection
+        while (uring->conns[i].send_head != NULL) {
+            uring_send_t *send = uring->conns[i].send_head;
+            uring->conns[i].send_head = send->next;
+            URING_send_free(uring, send);
+        }
+    }
+    while (uring->free_sends != NULL) {
+        uring_send_t *send = uring->free_sends;
+        uring->free_sends = send->next;
+        free(send->data);
+        free(send);
+    }
+    free(uring->conns);
+    free(uring->free_list);
+    free(uring->poll_fds);
+    free(uring->poll_map);
+    uring->conns = NULL;
+    uring->free_list = NULL;
+    uring->poll_fds = NULL;
+    uring->poll_map = NULL;
+}
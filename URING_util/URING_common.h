@@ -0,0 +1,124 @@
+#pragma once
+#ifndef URING_COMMON_H
+#define URING_COMMON_H
+
+//  Standard Libraries
+#include <errno.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/socket.h>                                                                             //  Before UDP_common.h so msghdr keeps its kernel layout
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <linux/io_uring.h>
+
+//  Developed Libraries
+#include "../UDP_util/UDP_common.h"
+
+//  URING Misc.
+#define URING_DEFAULT_ENTRIES               (256)           //  Submission queue size
+#define URING_DEFAULT_BUFF_COUNT            (512)           //  Provided receive buffers, rounded up to a power of two
+#define URING_DEFAULT_BUFF_SIZE             (2048)          //  Bytes per provided receive buffer
+#define URING_BUFF_GROUP                    (0)             //  Buffer group id of the provided buffer ring
+
+struct _uring_info_t;
+struct _uring_conn_t;
+
+//  Receive callback, called from URING_poll
+//  len > 0: bytes in data, from is the sender for UDP and NULL for TCP
+//  len == 0: TCP peer closed, len < 0: -errno. Receiving stops after either
+//  data is only valid during the call, its buffer goes back to the kernel afterwards
+typedef void (*uring_recv_cb_t)(struct _uring_info_t *uring, struct _uring_conn_t *conn, const uint8_t *data, int32_t len, const struct sockaddr_in *from);
+
+#pragma pack(push, 8)
+//  One Queued Send, the message is copied so the caller's buffer is free on return
+typedef struct _uring_send_t {
+    struct _uring_send_t *next;
+    struct _uring_conn_t *conn;
+    uint8_t *data;
+    uint32_t len;
+    uint32_t done;                                                                                  //  Bytes already sent, TCP only
+    uint32_t cap;
+    struct iovec iov;
+    struct msghdr msg;
+    struct sockaddr_in addr_info;
+} uring_send_t;
+
+//  URING Connection Struct, one per registered socket. user is free for the caller's own state
+typedef struct _uring_conn_t {
+    int32_t fd;
+    uint32_t index;                                                                                 //  Slot in the connection pool
+    uint8_t stream;                                                                                 //  1 for TCP, 0 for UDP
+    uint8_t recv_armed;
+    uint8_t closing;
+    struct sockaddr_in addr_info;                                                                   //  UDP destination, follows the last sender like UDP_server_recv
+    struct msghdr recv_msg;                                                                         //  Name layout for UDP receives
+    struct sockaddr_in recv_addr;
+    uring_send_t *send_head;                                                                        //  TCP sends wait here so only one is in flight
+    uring_send_t *send_tail;
+    uint32_t sends_inflight;
+    uint8_t needs_issue;                                                                            //  Head send is waiting for a free SQE
+    uring_recv_cb_t on_recv;
+    void *user;
+} uring_conn_t, *p_uring_conn_t;
+
+//  URING Information Struct
+//  Receives are multishot into a ring of provided buffers, so one armed request keeps delivering
+//  without a syscall per message. Sends are queued as SQEs and go out for every socket in one
+//  io_uring_enter. fallback is set when io_uring is missing and the calls use poll, recv and send
+typedef struct _uring_info_t {
+    int32_t ring_fd;
+    uint8_t fallback;
+    uint8_t multishot;                                                                              //  Cleared if the kernel refuses multishot receives
+    uint32_t features;
+    //  Submission Queue
+    uint8_t *sq_ring;
+    size_t sq_ring_size;
+    _Atomic uint32_t *sq_head;
+    _Atomic uint32_t *sq_tail;
+    uint32_t *sq_array;
+    uint32_t sq_mask;
+    uint32_t sq_entries;
+    uint32_t sqe_tail;                                                                              //  SQEs filled but not yet published
+    uint32_t sqe_submitted;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    //  Completion Queue
+    uint8_t *cq_ring;
+    size_t cq_ring_size;
+    _Atomic uint32_t *cq_head;
+    _Atomic uint32_t *cq_tail;
+    uint32_t cq_mask;
+    struct io_uring_cqe *cqes;
+    //  Provided Buffer Ring
+    struct io_uring_buf_ring *buf_ring;
+    size_t buf_ring_size;
+    uint8_t *buffs;
+    uint32_t buff_count;
+    uint32_t buff_size;
+    uint16_t buf_tail;
+    //  Connections and Send Slots
+    uint32_t max_conns;
+    uring_conn_t *conns;
+    uint32_t *free_list;
+    uint32_t free_count;
+    uring_send_t *free_sends;
+    uint32_t stalled;                                                                               //  Connections with needs_issue set
+    struct pollfd *poll_fds;                                                                        //  Fallback only
+    uint32_t *poll_map;                                                                             //  poll_fds entry to connection slot
+} uring_info_t, *p_uring_info_t;
+#pragma pack(pop)
+
+//  Declare Functions
+int32_t URING_init(uring_info_t *uring, uint32_t entries, uint32_t max_conns, uint32_t buff_count, uint32_t buff_size);
+uring_conn_t *URING_add_tcp(uring_info_t *uring, int32_t fd, uring_recv_cb_t on_recv, void *user);
+uring_conn_t *URING_add_udp(uring_info_t *uring, udp_info_t *udp_info, uring_recv_cb_t on_recv, void *user);
+void URING_remove(uring_info_t *uring, uring_conn_t *conn);
+int32_t URING_send(uring_info_t *uring, uring_conn_t *conn, const uint8_t *send_msg, uint32_t send_len);
+int32_t URING_submit(uring_info_t *uring);
+int32_t URING_poll(uring_info_t *uring, int32_t timeout_ms);
+void URING_close(uring_info_t *uring);
+
+#endif